@@ -0,0 +1,40 @@
+#include "allocation_counter.h"
+
+#ifdef SEARCH_SERVER_BENCHMARKS
+
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace {
+thread_local size_t allocation_count = 0;
+}
+
+size_t GetThreadAllocationCount() {
+    return allocation_count;
+}
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* pointer = malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+#else
+
+size_t GetThreadAllocationCount() {
+    return 0;
+}
+
+#endif
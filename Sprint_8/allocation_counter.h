@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+// Число выделений памяти через operator new в текущем потоке с его запуска.
+// Счётчик заменяет operator new для всей программы, поэтому он собирается только
+// с -DSEARCH_SERVER_BENCHMARKS; без флага выделения не считаются и функция возвращает 0
+#ifdef SEARCH_SERVER_BENCHMARKS
+inline constexpr bool ALLOCATION_COUNTING_ENABLED = true;
+#else
+inline constexpr bool ALLOCATION_COUNTING_ENABLED = false;
+#endif
+
+size_t GetThreadAllocationCount();
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Невладеющий взгляд на непрерывный массив: вектор в памяти или участок отображённого файла
+template <typename Type>
+class ArrayView {
+public:
+    ArrayView() = default;
+
+    ArrayView(const Type* data, size_t size)
+    : data_(data)
+    , size_(size) {
+    }
+
+    ArrayView(const std::vector<Type>& vector)
+    : data_(vector.data())
+    , size_(vector.size()) {
+    }
+
+    const Type* begin() const {
+        return data_;
+    }
+
+    const Type* end() const {
+        return data_ + size_;
+    }
+
+    const Type* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const Type& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    const Type& back() const {
+        return data_[size_ - 1];
+    }
+
+private:
+    const Type* data_ = nullptr;
+    size_t size_ = 0;
+};
@@ -0,0 +1,902 @@
+#include "benchmarks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "allocation_counter.h"
+#include "concurrent_search_server.h"
+#include "log_duration.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+#include "stop_word_filter.h"
+
+using namespace std;
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        const int length = uniform_int_distribution(1, max_length)(generator);
+        string word;
+        word.reserve(length);
+        for (int j = 0; j < length; ++j) {
+            word.push_back(uniform_int_distribution<int>('a', 'z')(generator));
+        }
+        words.push_back(move(word));
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob) {
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return query;
+}
+
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    }
+    return queries;
+}
+
+size_t GetResidentMemoryKb() {
+    ifstream status("/proc/self/status"s);
+    string line;
+    while (getline(status, line)) {
+        if (line.rfind("VmRSS:"s, 0) == 0) {
+            return stoul(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+namespace {
+using LegacyIndex = map<string_view, map<int, double>>;
+
+// Поиск по прежней раскладке индекса, повторяет исходный FindTopDocuments
+vector<Document> LegacyFindTopDocuments(const LegacyIndex& index, const map<int, int>& ratings, string_view raw_query) {
+    set<string_view> plus_words;
+    set<string_view> minus_words;
+    for (string_view word : SplitIntoWords(raw_query)) {
+        if (word[0] == '-') {
+            minus_words.insert(word.substr(1));
+        } else {
+            plus_words.insert(word);
+        }
+    }
+    map<int, double> document_to_relevance;
+    for (const string_view word : plus_words) {
+        if (index.count(word) == 0) {
+            continue;
+        }
+        const double inverse_document_freq = log(ratings.size() * 1.0 / index.at(word).size());
+        for (const auto [document_id, term_freq] : index.at(word)) {
+            if (ratings.at(document_id) > 0) {
+                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+            }
+        }
+    }
+    for (const string_view word : minus_words) {
+        if (index.count(word) == 0) {
+            continue;
+        }
+        for (const auto [document_id, _] : index.at(word)) {
+            document_to_relevance.erase(document_id);
+        }
+    }
+    vector<Document> matched_documents;
+    for (const auto [document_id, relevance] : document_to_relevance) {
+        matched_documents.push_back({document_id, relevance, ratings.at(document_id)});
+    }
+    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
+        if (abs(lhs.relevance - rhs.relevance) < 1e-6) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.relevance > rhs.relevance;
+    });
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return matched_documents;
+}
+
+// Прежний разбор текста: find по пробелам в новый вектор и отдельная проверка каждого слова
+vector<string_view> LegacySplitIntoWordsChecked(string_view text) {
+    vector<string_view> words;
+    while (true) {
+        const auto space_pos = text.find(' ');
+        words.push_back(text.substr(0, space_pos));
+        if (space_pos == text.npos) {
+            break;
+        }
+        text.remove_prefix(space_pos + 1);
+    }
+    for (const string_view word : words) {
+        if (any_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; })) {
+            throw invalid_argument("Word is invalid"s);
+        }
+    }
+    return words;
+}
+
+// Частоты слов как в живом тексте: немногие слова встречаются почти везде
+string GenerateSkewedText(mt19937& generator, const vector<string>& dictionary, int word_count) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        const double position = pow(uniform_real_distribution<>(0, 1)(generator), 3);
+        text += dictionary[static_cast<size_t>(position * (dictionary.size() - 1))];
+        text.push_back(' ');
+    }
+    text.pop_back();
+    return text;
+}
+}
+
+void BenchmarkIndexLayout(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 10);
+
+    const size_t memory_before = GetResidentMemoryKb();
+    SearchServer search_server(dictionary[0]);
+    {
+        LOG_DURATION("Build flat index"s);
+        for (int i = 0; i < document_count; ++i) {
+            search_server.AddDocument(i, GenerateQuery(generator, dictionary, 20), DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+    }
+    const size_t memory_server = GetResidentMemoryKb();
+
+    // Отдельно строим обе раскладки списков словопозиций тем же способом, чтобы сравнить память
+    vector<vector<pair<int, double>>> flat_postings;
+    unordered_map<string_view, int> flat_term_ids;
+    for (const int document_id : search_server) {
+        for (const auto [word, term_freq] : search_server.GetWordFrequencies(document_id)) {
+            const auto [it, inserted] = flat_term_ids.emplace(word, flat_postings.size());
+            if (inserted) {
+                flat_postings.emplace_back();
+            }
+            flat_postings[it->second].emplace_back(document_id, term_freq);
+        }
+    }
+    const size_t memory_flat_postings = GetResidentMemoryKb();
+
+    LegacyIndex legacy_index;
+    map<int, int> legacy_ratings;
+    for (const int document_id : search_server) {
+        legacy_ratings[document_id] = 2;
+        for (const auto [word, term_freq] : search_server.GetWordFrequencies(document_id)) {
+            legacy_index[word][document_id] = term_freq;
+        }
+    }
+    const size_t memory_legacy_postings = GetResidentMemoryKb();
+
+    cout << "Documents: "s << document_count << endl;
+    cout << "SearchServer resident memory: "s << (memory_server - memory_before) / 1024 << " MB"s << endl;
+    cout << "Flat posting lists: "s << (memory_flat_postings - memory_server) / 1024 << " MB"s << endl;
+    cout << "Legacy posting maps: "s << (memory_legacy_postings - memory_flat_postings) / 1024 << " MB"s << endl;
+
+    size_t total = 0;
+    {
+        LOG_DURATION("Flat index, 1000 queries"s);
+        for (const string& query : queries) {
+            total += search_server.FindTopDocuments(query).size();
+        }
+    }
+    {
+        LOG_DURATION("Legacy index, 1000 queries"s);
+        for (const string& query : queries) {
+            total += LegacyFindTopDocuments(legacy_index, legacy_ratings, query).size();
+        }
+    }
+    cout << total << endl;
+}
+
+void BenchmarkPostingCompression(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 10);
+
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, GenerateQuery(generator, dictionary, 20), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+
+    size_t total = 0;
+    for (const PostingFormat format : {PostingFormat::PLAIN, PostingFormat::COMPRESSED}) {
+        const string name = format == PostingFormat::PLAIN ? "Plain"s : "Compressed"s;
+        search_server.SetPostingFormat(format);
+        cout << name << " posting lists: "s << search_server.GetPostingMemoryUsage() / 1024 / 1024 << " MB"s << endl;
+        LOG_DURATION(name + " postings, 1000 queries"s);
+        for (const string& query : queries) {
+            total += search_server.FindTopDocuments(query).size();
+        }
+    }
+    cout << total << endl;
+}
+
+void BenchmarkTopDocumentSelection(int document_count) {
+    mt19937 generator;
+    // Запрос с низкой селективностью: совпадают почти все документы корпуса
+    vector<Document> matched_documents;
+    matched_documents.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        matched_documents.push_back({i, uniform_real_distribution<>(0, 10)(generator), uniform_int_distribution(-10, 10)(generator)});
+    }
+
+    const int repeat_count = 20;
+    int total = 0;
+    {
+        LOG_DURATION("Full sort, 20 queries"s);
+        for (int i = 0; i < repeat_count; ++i) {
+            auto documents = matched_documents;
+            sort(documents.begin(), documents.end(), IsMoreRelevant);
+            documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+            total += documents.front().id;
+        }
+    }
+    {
+        LOG_DURATION("Top-K partial_sort, 20 queries"s);
+        for (int i = 0; i < repeat_count; ++i) {
+            auto documents = matched_documents;
+            partial_sort(documents.begin(), documents.begin() + MAX_RESULT_DOCUMENT_COUNT, documents.end(), IsMoreRelevant);
+            documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+            total += documents.front().id;
+        }
+    }
+    cout << total << endl;
+}
+
+void BenchmarkDynamicPruning(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, GenerateSkewedText(generator, dictionary, 20), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    vector<string> queries;
+    for (int i = 0; i < 1'000; ++i) {
+        queries.push_back(GenerateSkewedText(generator, dictionary, 30));
+    }
+
+    size_t total = 0;
+    for (const QueryEngine engine : {QueryEngine::EXHAUSTIVE, QueryEngine::MAX_SCORE}) {
+        search_server.SetQueryEngine(engine);
+        LOG_DURATION((engine == QueryEngine::EXHAUSTIVE ? "Exhaustive"s : "MaxScore"s) + ", 1000 long queries"s);
+        for (const string& query : queries) {
+            total += search_server.FindTopDocuments(query).size();
+        }
+    }
+    cout << total << endl;
+}
+
+void BenchmarkMinusWords(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, GenerateSkewedText(generator, dictionary, 20), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    // Плюс-слова из середины словаря, минус-слова - из самых частых
+    vector<string> queries;
+    vector<string> minus_queries;
+    for (int i = 0; i < 1'000; ++i) {
+        queries.push_back(GenerateQuery(generator, vector(dictionary.begin() + 1'000, dictionary.begin() + 5'000), 3));
+        minus_queries.push_back(queries.back() + " -"s + dictionary[1 + i % 3] + " -"s + dictionary[4 + i % 3]);
+    }
+
+    search_server.SetQueryEngine(QueryEngine::EXHAUSTIVE);
+    size_t total = 0;
+    for (const auto* query_set : {&queries, &minus_queries}) {
+        LOG_DURATION(query_set == &queries ? "Without minus words, 1000 queries"s : "With frequent minus words, 1000 queries"s);
+        for (const string& query : *query_set) {
+            total += search_server.FindTopDocuments(query).size();
+        }
+    }
+    cout << total << endl;
+}
+
+void BenchmarkParallelScoring(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, GenerateSkewedText(generator, dictionary, 20), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    // Тяжёлые запросы из частых слов задевают большую часть корпуса
+    vector<string> queries;
+    for (int i = 0; i < 20; ++i) {
+        queries.push_back(GenerateQuery(generator, vector(dictionary.begin() + 1, dictionary.begin() + 50), 10));
+    }
+
+    search_server.SetQueryEngine(QueryEngine::EXHAUSTIVE);
+    size_t total = 0;
+    {
+        LOG_DURATION("Sequential scoring, 20 heavy queries"s);
+        for (const string& query : queries) {
+            total += search_server.FindTopDocuments(execution::seq, query).size();
+        }
+    }
+    {
+        LOG_DURATION("Parallel scoring, 20 heavy queries"s);
+        for (const string& query : queries) {
+            total += search_server.FindTopDocuments(execution::par, query).size();
+        }
+    }
+    cout << total << endl;
+}
+
+void BenchmarkIngestion(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    vector<string> texts;
+    texts.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        texts.push_back(GenerateSkewedText(generator, dictionary, 50));
+    }
+    vector<RawDocument> documents;
+    documents.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        documents.push_back({i, texts[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+
+    auto report = [document_count](const string& name, chrono::steady_clock::duration duration) {
+        const double seconds = chrono::duration<double>(duration).count();
+        cout << name << ": "s << static_cast<int>(document_count / seconds) << " documents/s"s << endl;
+    };
+    {
+        SearchServer search_server(dictionary[0]);
+        const auto start = chrono::steady_clock::now();
+        for (const RawDocument& document : documents) {
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        report("AddDocument"s, chrono::steady_clock::now() - start);
+    }
+    {
+        SearchServer search_server(dictionary[0]);
+        const auto start = chrono::steady_clock::now();
+        search_server.AddDocuments(execution::par, documents);
+        report("AddDocuments(par)"s, chrono::steady_clock::now() - start);
+    }
+}
+
+void BenchmarkSnapshot(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    vector<string> texts;
+    texts.reserve(document_count);
+    vector<RawDocument> documents;
+    documents.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        texts.push_back(GenerateSkewedText(generator, dictionary, 50));
+    }
+    for (int i = 0; i < document_count; ++i) {
+        documents.push_back({i, texts[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 5);
+    const string path = "search_server_snapshot.bin"s;
+
+    SearchServer search_server(dictionary[0]);
+    search_server.SetPostingFormat(PostingFormat::COMPRESSED);
+    {
+        LOG_DURATION("Build index"s);
+        search_server.AddDocuments(execution::par, documents);
+    }
+    {
+        LOG_DURATION("SaveSnapshot"s);
+        search_server.SaveSnapshot(path);
+    }
+    optional<SearchServer> loaded;
+    {
+        LOG_DURATION("LoadSnapshot"s);
+        loaded.emplace(SearchServer::LoadSnapshot(path));
+    }
+    // Первые запросы к загруженному индексу дочитывают страницы файла с диска
+    size_t found = 0;
+    {
+        LOG_DURATION("Queries after LoadSnapshot"s);
+        for (const string& query : queries) {
+            found += loaded->FindTopDocuments(query).size();
+        }
+    }
+    cout << "Found: "s << found << endl;
+    remove(path.c_str());
+}
+
+void BenchmarkLiveUpdates(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    vector<string> texts;
+    texts.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        texts.push_back(GenerateSkewedText(generator, dictionary, 50));
+    }
+    // id приходят вразнобой: в сжатый список их нельзя просто дописать в конец
+    vector<int> document_ids(document_count);
+    iota(document_ids.begin(), document_ids.end(), 0);
+    shuffle(document_ids.begin(), document_ids.end(), generator);
+    const auto queries = GenerateQueries(generator, dictionary, document_count / 10 + 1, 5);
+
+    for (const size_t write_segment_size : {static_cast<size_t>(document_count), SegmentedIndex::DEFAULT_WRITE_SEGMENT_SIZE}) {
+        SearchServer search_server(dictionary[0]);
+        search_server.SetPostingFormat(PostingFormat::COMPRESSED);
+        search_server.SetWriteSegmentSize(write_segment_size);
+        size_t found = 0;
+        {
+            LOG_DURATION((write_segment_size == static_cast<size_t>(document_count) ? "Single mutable index"s : "Segmented index"s)
+                         + ", adds with a query per 10 adds and removal per 5 adds"s);
+            for (int i = 0; i < document_count; ++i) {
+                search_server.AddDocument(document_ids[i], texts[i], DocumentStatus::ACTUAL, {1, 2, 3});
+                if (i % 5 == 4) {
+                    search_server.RemoveDocument(document_ids[i / 2]);
+                }
+                if (i % 10 == 9) {
+                    found += search_server.FindTopDocuments(queries[i / 10]).size();
+                }
+            }
+        }
+        cout << "Found: "s << found << endl;
+    }
+}
+
+void BenchmarkChurn(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    vector<string> texts;
+    texts.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        // Редкое слово у каждого документа: после удаления документа его слово должно уйти из словаря
+        texts.push_back(GenerateSkewedText(generator, dictionary, 50) + " rare"s + to_string(i));
+    }
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 5);
+    auto is_removed = [](int document_id) {
+        return document_id % 10 < 3;
+    };
+
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    {
+        LOG_DURATION("Removal of 30% with cleanup"s);
+        for (int i = 0; i < document_count; ++i) {
+            if (is_removed(i)) {
+                search_server.RemoveDocument(i);
+            }
+        }
+        search_server.CleanupRemovedDocuments();
+    }
+
+    SearchServer rebuilt_server(dictionary[0]);
+    {
+        LOG_DURATION("Rebuild of remaining 70%"s);
+        for (int i = 0; i < document_count; ++i) {
+            if (!is_removed(i)) {
+                rebuilt_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {1, 2, 3});
+            }
+        }
+    }
+
+    int mismatches = 0;
+    for (const string& query : queries) {
+        const auto found = search_server.FindTopDocuments(query);
+        const auto expected = rebuilt_server.FindTopDocuments(query);
+        mismatches += !equal(found.begin(), found.end(), expected.begin(), expected.end(), [](const Document& lhs, const Document& rhs) {
+            return lhs.id == rhs.id;
+        });
+    }
+    cout << "Queries with different results: "s << mismatches << endl;
+}
+
+void BenchmarkRemoveDuplicates(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    SearchServer search_server(dictionary[0]);
+    vector<string> texts;
+    for (int i = 0; i < document_count; ++i) {
+        // Каждый десятый документ повторяет слова одного из прежних в другом порядке
+        string text;
+        if (i % 10 == 9) {
+            auto words = SplitIntoWords(texts[uniform_int_distribution(0, i - 1)(generator)]);
+            shuffle(words.begin(), words.end(), generator);
+            for (const string_view word : words) {
+                if (!text.empty()) {
+                    text += ' ';
+                }
+                text += word;
+            }
+        } else {
+            text = GenerateSkewedText(generator, dictionary, 30);
+        }
+        search_server.AddDocument(i, text, DocumentStatus::ACTUAL, {1, 2, 3});
+        texts.push_back(move(text));
+    }
+
+    vector<int> expected;
+    {
+        LOG_DURATION("Duplicates via set<set<string>>"s);
+        set<set<string>> unique_documents;
+        for (const int document_id : search_server) {
+            set<string> words;
+            for (const auto& [word, _] : search_server.GetWordFrequencies(document_id)) {
+                words.emplace(word);
+            }
+            if (!unique_documents.insert(move(words)).second) {
+                expected.push_back(document_id);
+            }
+        }
+    }
+    vector<int> found;
+    {
+        LOG_DURATION("Duplicates via fingerprints, seq"s);
+        found = FindDuplicates(execution::seq, search_server);
+    }
+    {
+        LOG_DURATION("Duplicates via fingerprints, par"s);
+        found = FindDuplicates(execution::par, search_server);
+    }
+    cout << "Duplicates: "s << found.size() << (found == expected ? " (same)"s : " (MISMATCH)"s) << endl;
+}
+
+void BenchmarkNearDuplicates(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    // Попарное сравнение квадратично, поэтому корпус небольшой
+    const int indexed_count = min(document_count, 2'000);
+    const double jaccard_threshold = 0.8;
+    SearchServer search_server(dictionary[0]);
+    vector<string> texts;
+    for (int i = 0; i < indexed_count; ++i) {
+        // Каждый десятый документ - копия одного из прежних с заменой одного-двух слов
+        string text;
+        if (i % 10 == 9) {
+            auto words = SplitIntoWords(texts[uniform_int_distribution(0, i - 1)(generator)]);
+            for (int replaced = uniform_int_distribution(1, 2)(generator); replaced > 0; --replaced) {
+                words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)] = dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)];
+            }
+            for (const string_view word : words) {
+                if (!text.empty()) {
+                    text += ' ';
+                }
+                text += word;
+            }
+        } else {
+            text = GenerateSkewedText(generator, dictionary, 50);
+        }
+        search_server.AddDocument(i, text, DocumentStatus::ACTUAL, {1, 2, 3});
+        texts.push_back(move(text));
+    }
+
+    set<pair<int, int>> expected;
+    {
+        LOG_DURATION("Near duplicates, all pairs"s);
+        for (int lhs = 0; lhs < indexed_count; ++lhs) {
+            for (int rhs = lhs + 1; rhs < indexed_count; ++rhs) {
+                if (ComputeJaccardSimilarity(search_server.GetWordFrequencies(lhs), search_server.GetWordFrequencies(rhs)) >= jaccard_threshold) {
+                    expected.emplace(lhs, rhs);
+                }
+            }
+        }
+    }
+    set<pair<int, int>> found;
+    {
+        LOG_DURATION("Near duplicates, MinHash + LSH"s);
+        search_server.EnableNearDuplicateDetection(jaccard_threshold);
+        for (const int document_id : search_server) {
+            for (const int near_duplicate_id : search_server.FindNearDuplicates(document_id)) {
+                found.emplace(min(document_id, near_duplicate_id), max(document_id, near_duplicate_id));
+            }
+        }
+    }
+    const auto recalled = count_if(expected.begin(), expected.end(), [&found](const auto& pair) {
+        return found.count(pair) > 0;
+    });
+    cout << "Near-duplicate pairs: "s << expected.size() << ", found by LSH: "s << recalled << endl;
+}
+
+void BenchmarkTokenizer(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    vector<string> texts;
+    texts.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        texts.push_back(GenerateSkewedText(generator, dictionary, 100));
+    }
+    // Каждый способ пять раз проходит весь корпус; сумма длин слов не даёт выбросить работу
+    size_t total_length = 0;
+    {
+        LOG_DURATION("Tokenizer, find + vector + IsValidWord"s);
+        for (int round = 0; round < 5; ++round) {
+            for (const string& text : texts) {
+                for (const string_view word : LegacySplitIntoWordsChecked(text)) {
+                    total_length += word.size();
+                }
+            }
+        }
+    }
+    {
+        LOG_DURATION("Tokenizer, ForEachWord"s);
+        for (int round = 0; round < 5; ++round) {
+            for (const string& text : texts) {
+                ForEachWord(text, [&total_length](string_view word, bool is_valid) {
+                    if (!is_valid) {
+                        throw invalid_argument("Word is invalid"s);
+                    }
+                    total_length += word.size();
+                });
+            }
+        }
+    }
+    cout << "Total word length: "s << total_length << endl;
+}
+
+void BenchmarkQueryAllocations(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    SearchServer search_server(dictionary[0]);
+    const int indexed_count = min(document_count, 100'000);
+    for (int i = 0; i < indexed_count; ++i) {
+        search_server.AddDocument(i, GenerateSkewedText(generator, dictionary, 50), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    vector<string> queries;
+    for (int i = 0; i < 10'000; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, 8, 0.2));
+    }
+    vector<int> document_ids(queries.size());
+    for (int& document_id : document_ids) {
+        document_id = uniform_int_distribution(0, indexed_count - 1)(generator);
+    }
+
+    // Выделения под найденные слова тоже попадают в счёт, поэтому считаем отдельно запросы без совпадений
+    size_t matched_words = 0;
+    size_t allocations = 0;
+    size_t empty_match_allocations = 0;
+    size_t empty_match_count = 0;
+    {
+        LOG_DURATION("MatchDocument, 8-word queries"s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const size_t allocations_before = GetThreadAllocationCount();
+            const auto [words, status] = search_server.MatchDocument(queries[i], document_ids[i]);
+            const size_t query_allocations = GetThreadAllocationCount() - allocations_before;
+            allocations += query_allocations;
+            if (words.empty()) {
+                empty_match_allocations += query_allocations;
+                ++empty_match_count;
+            }
+            matched_words += words.size();
+        }
+    }
+    if (!ALLOCATION_COUNTING_ENABLED) {
+        cout << "Matched words: "s << matched_words << ", allocations are not counted without -DSEARCH_SERVER_BENCHMARKS"s << endl;
+        return;
+    }
+    cout << "Matched words: "s << matched_words << ", allocations per query: "s << static_cast<double>(allocations) / queries.size()
+         << ", per query without matches: "s << static_cast<double>(empty_match_allocations) / max<size_t>(empty_match_count, 1) << endl;
+}
+
+void BenchmarkMatchDocuments(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    SearchServer search_server(dictionary[0]);
+    const int indexed_count = min(document_count, 100'000);
+    for (int i = 0; i < indexed_count; ++i) {
+        search_server.AddDocument(i, GenerateSkewedText(generator, dictionary, 50), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    // Страница выдачи - 20 документов на запрос
+    vector<string> queries;
+    vector<vector<int>> pages;
+    for (int i = 0; i < 5'000; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, 8, 0.2));
+        vector<int>& page = pages.emplace_back(20);
+        for (int& document_id : page) {
+            document_id = uniform_int_distribution(0, indexed_count - 1)(generator);
+        }
+    }
+
+    size_t matched_words = 0;
+    {
+        LOG_DURATION("MatchDocument per document, 5000 pages"s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            for (const int document_id : pages[i]) {
+                matched_words += get<0>(search_server.MatchDocument(queries[i], document_id)).size();
+            }
+        }
+    }
+    {
+        LOG_DURATION("MatchDocuments per page, 5000 pages"s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            for (const auto& [words, status] : search_server.MatchDocuments(queries[i], pages[i])) {
+                matched_words += words.size();
+            }
+        }
+    }
+    cout << matched_words << endl;
+}
+
+void BenchmarkStopWords(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    set<string, less<>> stop_words;
+    while (stop_words.size() < 600) {
+        stop_words.insert(dictionary[uniform_int_distribution<size_t>(0, dictionary.size() - 1)(generator)]);
+    }
+    vector<string> texts;
+    texts.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        texts.push_back(GenerateSkewedText(generator, dictionary, 100));
+    }
+    vector<string_view> words;
+    for (const string& text : texts) {
+        ForEachWord(text, [&words](string_view word, bool) {
+            words.push_back(word);
+        });
+    }
+
+    size_t found = 0;
+    {
+        LOG_DURATION("Stop words, set<string>::count"s);
+        for (const string_view word : words) {
+            found += stop_words.count(word);
+        }
+    }
+    const StopWordFilter filter(stop_words);
+    {
+        LOG_DURATION("Stop words, StopWordFilter"s);
+        for (const string_view word : words) {
+            found += filter.Contains(word);
+        }
+    }
+    cout << "Stop words found: "s << found << endl;
+}
+
+void BenchmarkQueryCache(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, GenerateSkewedText(generator, dictionary, 50), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    // Запросы по закону Ципфа: i-й по популярности запрос встречается с весом 1 / (i + 1)
+    const auto distinct_queries = GenerateQueries(generator, dictionary, 10'000, 5);
+    vector<double> weights(distinct_queries.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        weights[i] = 1.0 / static_cast<double>(i + 1);
+    }
+    discrete_distribution<size_t> query_distribution(weights.begin(), weights.end());
+    vector<string_view> queries(10'000);
+    for (string_view& query : queries) {
+        query = distinct_queries[query_distribution(generator)];
+    }
+
+    for (const size_t capacity : {size_t{0}, size_t{1024}}) {
+        search_server.SetQueryCacheCapacity(capacity);
+        const CacheStatistics before = search_server.GetQueryCacheStatistics();
+        size_t found = 0;
+        {
+            LOG_DURATION("Zipfian queries, query cache capacity "s + to_string(capacity));
+            for (const string_view query : queries) {
+                found += search_server.FindTopDocuments(query).size();
+            }
+        }
+        const CacheStatistics after = search_server.GetQueryCacheStatistics();
+        const CacheStatistics run{after.hits - before.hits, after.misses - before.misses, after.size};
+        cout << "Found: "s << found << ", cache hit rate: "s << run.GetHitRate() << endl;
+    }
+}
+
+void BenchmarkResultCache(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, GenerateSkewedText(generator, dictionary, 50), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    const auto distinct_queries = GenerateQueries(generator, dictionary, 10'000, 5);
+    vector<double> weights(distinct_queries.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        weights[i] = 1.0 / static_cast<double>(i + 1);
+    }
+    discrete_distribution<size_t> query_distribution(weights.begin(), weights.end());
+    vector<string_view> queries(10'000);
+    for (string_view& query : queries) {
+        query = distinct_queries[query_distribution(generator)];
+    }
+
+    for (const size_t capacity : {size_t{0}, size_t{4096}}) {
+        search_server.SetResultCacheOptions({capacity, chrono::seconds(60)});
+        size_t found = 0;
+        {
+            LOG_DURATION("Zipfian queries, result cache capacity "s + to_string(capacity));
+            for (const string_view query : queries) {
+                found += search_server.FindTopDocuments(query).size();
+            }
+        }
+        const CacheStatistics statistics = search_server.GetResultCacheStatistics();
+        cout << "Found: "s << found << ", cache hit rate: "s << statistics.GetHitRate() << endl;
+    }
+}
+
+void BenchmarkConcurrentUpdates(int document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const int indexed_count = min(document_count, 100'000);
+    vector<string> texts;
+    texts.reserve(indexed_count * 2);
+    for (int i = 0; i < indexed_count * 2; ++i) {
+        texts.push_back(GenerateSkewedText(generator, dictionary, 50));
+    }
+    const auto queries = GenerateQueries(generator, dictionary, 1'000, 5);
+
+    ConcurrentSearchServer search_server(dictionary[0]);
+    for (int i = 0; i < indexed_count; ++i) {
+        search_server.AddDocument(i, texts[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+
+    const int reader_count = max(1u, thread::hardware_concurrency());
+    const auto duration = chrono::seconds(2);
+    // Запросов в секунду у reader_count читателей; при updates_per_second > 0 параллельно
+    // работает писатель: добавляет новый документ и удаляет самый старый
+    auto measure = [&](int updates_per_second) {
+        atomic<bool> stop = false;
+        atomic<long> query_count = 0;
+        vector<thread> readers;
+        for (int reader = 0; reader < reader_count; ++reader) {
+            readers.emplace_back([&, reader] {
+                long count = 0;
+                for (size_t i = reader; !stop; i = (i + reader_count) % queries.size()) {
+                    search_server.FindTopDocuments(queries[i]);
+                    ++count;
+                }
+                query_count += count;
+            });
+        }
+        int update_count = 0;
+        const auto start = chrono::steady_clock::now();
+        if (updates_per_second > 0) {
+            int next_id = indexed_count;
+            for (auto now = start; now - start < duration; now = chrono::steady_clock::now()) {
+                const int id = next_id++;
+                search_server.AddDocument(id, texts[id % texts.size()], DocumentStatus::ACTUAL, {1, 2, 3});
+                search_server.RemoveDocument(id - indexed_count);
+                ++update_count;
+                this_thread::sleep_until(start + update_count * chrono::microseconds(1'000'000 / updates_per_second));
+            }
+        } else {
+            this_thread::sleep_for(duration);
+        }
+        stop = true;
+        for (thread& reader : readers) {
+            reader.join();
+        }
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << reader_count << " readers, "s << static_cast<int>(update_count / seconds) << " updates/s: "s
+             << static_cast<int>(query_count / seconds) << " queries/s"s << endl;
+    };
+    measure(0);
+    measure(1'000);
+}
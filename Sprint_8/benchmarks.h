@@ -0,0 +1,69 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Генераторы случайного корпуса для замеров
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0);
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count);
+
+// Резидентная память процесса в килобайтах (0, если /proc недоступен)
+size_t GetResidentMemoryKb();
+
+// Сравнение плоского индекса с прежней раскладкой map<string_view, map<int, double>>:
+// пропускная способность запросов и занимаемая память
+void BenchmarkIndexLayout(int document_count);
+
+// Память и скорость запросов для форматов PLAIN и COMPRESSED списков словопозиций
+void BenchmarkPostingCompression(int document_count);
+
+// Выбор лучших документов: полная сортировка против partial_sort на широкой выдаче
+void BenchmarkTopDocumentSelection(int document_count);
+
+// Длинные запросы: полный перебор словопозиций против MaxScore
+void BenchmarkDynamicPruning(int document_count);
+
+// Запросы из редких слов без минус-слов и с частыми минус-словами
+void BenchmarkMinusWords(int document_count);
+
+// Один тяжёлый запрос: последовательный подсчёт против параллельного по диапазонам id
+void BenchmarkParallelScoring(int document_count);
+
+// Число выделений памяти на разбор запроса в MatchDocument
+void BenchmarkQueryAllocations(int document_count);
+
+// Страница выдачи: MatchDocument для каждого документа против MatchDocuments с одним разбором запроса
+void BenchmarkMatchDocuments(int document_count);
+
+// Проверка 600 стоп-слов: set<string>::count против StopWordFilter
+void BenchmarkStopWords(int document_count);
+
+// Запросы с распределением Ципфа без кеша планов запросов и с ним, затем без кеша результатов и с ним
+void BenchmarkQueryCache(int document_count);
+void BenchmarkResultCache(int document_count);
+
+// Скорость загрузки корпуса: AddDocument по одному против пакетного AddDocuments
+void BenchmarkIngestion(int document_count);
+
+// Время сохранения снимка индекса и загрузки через отображение файла в память против построения заново
+void BenchmarkSnapshot(int document_count);
+
+// Загрузка вперемешку с удалениями и запросами: один изменяемый индекс против сегментов с фоновым слиянием
+void BenchmarkLiveUpdates(int document_count);
+
+// Удаление 30% корпуса с пакетной очисткой против построения оставшихся документов заново
+void BenchmarkChurn(int document_count);
+
+// Поиск дубликатов: множество наборов слов против параллельных отпечатков
+void BenchmarkRemoveDuplicates(int document_count);
+
+// Почти одинаковые документы: попарное сравнение против MinHash-подписей с LSH
+void BenchmarkNearDuplicates(int document_count);
+
+// Разбор текста на слова: find с вектором и проверкой слов против ForEachWord
+void BenchmarkTokenizer(int document_count);
+
+// Пропускная способность запросов ConcurrentSearchServer без изменений и при 1000 изменений в секунду
+void BenchmarkConcurrentUpdates(int document_count);
@@ -0,0 +1,95 @@
+#include "concurrent_search_server.h"
+
+ConcurrentSearchServer::ConcurrentSearchServer(const std::string& stop_words_text)
+: ConcurrentSearchServer(std::string_view(stop_words_text))
+{
+}
+
+ConcurrentSearchServer::ConcurrentSearchServer(std::string_view stop_words_text)
+: ConcurrentSearchServer(SplitIntoWords(stop_words_text))
+{
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Apply([document_id, document = std::string(document), status, ratings](SearchServer& server) {
+        server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Apply([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::CleanupRemovedDocuments() {
+    Apply([](SearchServer& server) {
+        server.CleanupRemovedDocuments();
+    });
+}
+
+void ConcurrentSearchServer::CompactTermTexts() {
+    Apply([](SearchServer& server) {
+        server.CompactTermTexts();
+    });
+}
+
+void ConcurrentSearchServer::SetPostingFormat(PostingFormat format) {
+    Apply([format](SearchServer& server) {
+        server.SetPostingFormat(format);
+    });
+}
+
+void ConcurrentSearchServer::SetQueryEngine(QueryEngine engine) {
+    Apply([engine](SearchServer& server) {
+        server.SetQueryEngine(engine);
+    });
+}
+
+namespace {
+ConcurrentSearchServer::MatchedDocument CopyMatchedWords(const SearchServer::MatchedDocument& matched_document) {
+    const auto& [words, status] = matched_document;
+    return {std::vector<std::string>(words.begin(), words.end()), status};
+}
+}
+
+ConcurrentSearchServer::MatchedDocument ConcurrentSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    return Read([&](const SearchServer& server) {
+        return CopyMatchedWords(server.MatchDocument(raw_query, document_id));
+    });
+}
+
+std::vector<ConcurrentSearchServer::MatchedDocument> ConcurrentSearchServer::MatchDocuments(std::string_view raw_query,
+                                                                                          ArrayView<int> document_ids) const {
+    return Read([&](const SearchServer& server) {
+        std::vector<MatchedDocument> matched_documents;
+        matched_documents.reserve(document_ids.size());
+        for (const auto& matched_document : server.MatchDocuments(raw_query, document_ids)) {
+            matched_documents.push_back(CopyMatchedWords(matched_document));
+        }
+        return matched_documents;
+    });
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer& server) {
+        return server.GetDocumentCount();
+    });
+}
+
+void ConcurrentSearchServer::Apply(std::function<void(SearchServer&)> update) {
+    std::lock_guard lock(update_mutex_);
+    SearchServer& spare = *servers_[current_.load() == servers_[0].get()];
+    if (!pending_updates_.empty()) {
+        RcuWaitForGracePeriod(grace_period_);
+        for (const auto& pending_update : pending_updates_) {
+            pending_update(spare);
+        }
+        pending_updates_.clear();
+    }
+    // Исключение здесь оставляет опубликованную копию прежней, а резервную - догнавшей её
+    update(spare);
+    current_.store(&spare);
+    grace_period_ = RcuStartGracePeriod();
+    pending_updates_.push_back(std::move(update));
+}
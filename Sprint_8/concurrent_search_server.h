@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "rcu.h"
+#include "search_server.h"
+
+// Поисковый сервер для одновременных запросов и изменений. Хранит две копии SearchServer:
+// читатели работают с опубликованной, писатель меняет вторую и атомарно публикует её.
+// То же изменение повторяется в старой копии перед следующим изменением, после периода
+// ожидания RCU, за который из неё обычно уже вышли все читатели. Читатели не берут блокировок
+// и видят согласованное состояние; за это каждое изменение выполняется дважды,
+// и тексты документов хранятся в двух копиях
+class ConcurrentSearchServer {
+public:
+    template <typename StringContainer>
+    explicit ConcurrentSearchServer(const StringContainer& stop_words);
+    explicit ConcurrentSearchServer(const std::string& stop_words_text);
+    explicit ConcurrentSearchServer(std::string_view stop_words_text);
+
+    // Изменения выстраиваются в очередь на мьютексе писателя. Если изменение выбросило
+    // исключение, опубликованная копия не изменилась
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    void CleanupRemovedDocuments();
+    void CompactTermTexts();
+    void SetPostingFormat(PostingFormat format);
+    void SetQueryEngine(QueryEngine engine);
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const;
+
+    // Слова копируются: копия сервера, на которую указывали бы string_view, после выхода
+    // читателей меняется и может освободить память слов
+    using MatchedDocument = std::tuple<std::vector<std::string>, DocumentStatus>;
+    MatchedDocument MatchDocument(std::string_view raw_query, int document_id) const;
+    std::vector<MatchedDocument> MatchDocuments(std::string_view raw_query, ArrayView<int> document_ids) const;
+    int GetDocumentCount() const;
+
+    // Вызывает function(const SearchServer&) на опубликованной копии. Всё, что function
+    // получает из сервера по ссылке, действительно только внутри вызова. Менять
+    // этот ConcurrentSearchServer из function нельзя
+    template <typename Function>
+    auto Read(Function function) const;
+
+private:
+    std::array<std::unique_ptr<SearchServer>, 2> servers_;
+    std::atomic<const SearchServer*> current_;
+    std::mutex update_mutex_;
+    // Изменения, уже опубликованные, но ещё не повторённые в резервной копии
+    std::vector<std::function<void(SearchServer&)>> pending_updates_;
+    uint64_t grace_period_ = 0;
+
+    // update должна владеть своими данными: она выполняется повторно после возврата из Apply
+    void Apply(std::function<void(SearchServer&)> update);
+};
+
+template <typename StringContainer>
+ConcurrentSearchServer::ConcurrentSearchServer(const StringContainer& stop_words)
+: servers_{std::make_unique<SearchServer>(stop_words), std::make_unique<SearchServer>(stop_words)}
+, current_(servers_[0].get())
+{
+}
+
+template <typename... Args>
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(Args&&... args) const {
+    return Read([&](const SearchServer& server) {
+        return server.FindTopDocuments(std::forward<Args>(args)...);
+    });
+}
+
+template <typename Function>
+auto ConcurrentSearchServer::Read(Function function) const {
+    RcuReadGuard guard;
+    return function(*current_.load());
+}
@@ -1,5 +1,10 @@
 #pragma once
+#include <cmath>
 #include <iostream>
+#include <string_view>
+#include <vector>
+
+const double RELEVANCE_EPSILON = 1e-6;
 
 struct Document {
     Document() = default;
@@ -17,6 +22,18 @@ struct Document {
 
 std::ostream& operator<<(std::ostream& out, const Document& document);
 
+// Порядок выдачи: по убыванию релевантности, при равной релевантности - по убыванию рейтинга.
+// Полностью равные документы упорядочиваются по id, чтобы выдача не зависела от алгоритма отбора
+inline bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_EPSILON) {
+        if (lhs.rating == rhs.rating) {
+            return lhs.id < rhs.id;
+        }
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
 enum class DocumentStatus {
     ACTUAL,
     IRRELEVANT,
@@ -25,3 +42,11 @@ enum class DocumentStatus {
 };
 
 
+
+// Документ для пакетного добавления через SearchServer::AddDocuments
+struct RawDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
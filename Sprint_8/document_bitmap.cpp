@@ -0,0 +1,20 @@
+#include "document_bitmap.h"
+
+void DocumentBitmap::Insert(size_t ordinal) {
+    const size_t word = ordinal / 64;
+    if (word >= words_.size()) {
+        words_.resize(word + 1, 0);
+    }
+    words_[word] |= uint64_t{1} << (ordinal % 64);
+}
+
+void DocumentBitmap::Erase(size_t ordinal) {
+    const size_t word = ordinal / 64;
+    if (word < words_.size()) {
+        words_[word] &= ~(uint64_t{1} << (ordinal % 64));
+    }
+}
+
+size_t DocumentBitmap::GetMemoryUsage() const {
+    return words_.capacity() * sizeof(uint64_t);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Множество порядковых номеров документов - битовая карта. Проверка принадлежности - одно
+// чтение слова, поэтому её можно делать на каждой словопозиции
+class DocumentBitmap {
+public:
+    void Insert(size_t ordinal);
+    void Erase(size_t ordinal);
+    bool Contains(size_t ordinal) const;
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<uint64_t> words_;
+};
+
+inline bool DocumentBitmap::Contains(size_t ordinal) const {
+    const size_t word = ordinal / 64;
+    return word < words_.size() && ((words_[word] >> (ordinal % 64)) & 1) != 0;
+}
@@ -0,0 +1,70 @@
+#include "forward_index.h"
+
+using namespace std;
+
+void ForwardIndex::AddDocument(int ordinal, vector<pair<int, double>> term_freqs) {
+    sort(term_freqs.begin(), term_freqs.end());
+    if (static_cast<size_t>(ordinal) >= entries_.size()) {
+        entries_.resize(ordinal + 1);
+    }
+    entries_[ordinal] = {term_ids_.size(), static_cast<uint32_t>(term_freqs.size()), true, false};
+    for (const auto& [term_id, term_freq] : term_freqs) {
+        term_ids_.push_back(term_id);
+        term_freqs_.push_back(term_freq);
+    }
+}
+
+void ForwardIndex::RemoveDocument(int ordinal) {
+    Entry& entry = entries_.at(ordinal);
+    if (entry.is_present && !entry.is_removed) {
+        entry.is_removed = true;
+        removed_size_ += entry.size;
+    }
+}
+
+void ForwardIndex::CompactIfNeeded() {
+    if (removed_size_ == 0 || removed_size_ * 2 < term_ids_.size()) {
+        return;
+    }
+    vector<int> term_ids;
+    vector<double> term_freqs;
+    term_ids.reserve(term_ids_.size() - removed_size_);
+    term_freqs.reserve(term_ids_.size() - removed_size_);
+    for (Entry& entry : entries_) {
+        if (entry.is_removed) {
+            entry = {};
+        } else if (entry.is_present) {
+            const uint64_t offset = term_ids.size();
+            term_ids.insert(term_ids.end(), term_ids_.begin() + entry.offset, term_ids_.begin() + entry.offset + entry.size);
+            term_freqs.insert(term_freqs.end(), term_freqs_.begin() + entry.offset, term_freqs_.begin() + entry.offset + entry.size);
+            entry.offset = offset;
+        }
+    }
+    term_ids_ = move(term_ids);
+    term_freqs_ = move(term_freqs);
+    removed_size_ = 0;
+}
+
+bool ForwardIndex::Contains(int ordinal) const {
+    return ordinal >= 0 && static_cast<size_t>(ordinal) < entries_.size() && entries_[ordinal].is_present;
+}
+
+ArrayView<int> ForwardIndex::GetTermIds(int ordinal) const {
+    if (!Contains(ordinal)) {
+        return {};
+    }
+    const Entry& entry = entries_[ordinal];
+    return {term_ids_.data() + entry.offset, entry.size};
+}
+
+ArrayView<double> ForwardIndex::GetTermFreqs(int ordinal) const {
+    if (!Contains(ordinal)) {
+        return {};
+    }
+    const Entry& entry = entries_[ordinal];
+    return {term_freqs_.data() + entry.offset, entry.size};
+}
+
+size_t ForwardIndex::GetMemoryUsage() const {
+    return entries_.capacity() * sizeof(Entry) + term_ids_.capacity() * sizeof(int) + term_freqs_.capacity() * sizeof(double);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "array_view.h"
+
+// Слова документа с их TF: term_id по возрастанию и TF в тех же позициях. При обходе
+// выдаёт пары (слово, TF). Действителен до следующего изменения сервера, из которого получен
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+
+        Iterator(const WordFrequencies* words, size_t index)
+        : words_(words)
+        , index_(index) {
+        }
+
+        value_type operator*() const {
+            return {words_->terms_[words_->term_ids_[index_]], words_->term_freqs_[index_]};
+        }
+
+        Iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++index_;
+            return previous;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        const WordFrequencies* words_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    WordFrequencies() = default;
+
+    // terms - словарь term_id -> слово
+    WordFrequencies(const std::string_view* terms, ArrayView<int> term_ids, ArrayView<double> term_freqs)
+    : terms_(terms)
+    , term_ids_(term_ids)
+    , term_freqs_(term_freqs) {
+    }
+
+    Iterator begin() const {
+        return {this, 0};
+    }
+
+    Iterator end() const {
+        return {this, term_ids_.size()};
+    }
+
+    size_t size() const {
+        return term_ids_.size();
+    }
+
+    bool empty() const {
+        return term_ids_.empty();
+    }
+
+    ArrayView<int> GetTermIds() const {
+        return term_ids_;
+    }
+
+    ArrayView<double> GetTermFreqs() const {
+        return term_freqs_;
+    }
+
+    bool ContainsTerm(int term_id) const {
+        return std::binary_search(term_ids_.begin(), term_ids_.end(), term_id);
+    }
+
+private:
+    const std::string_view* terms_ = nullptr;
+    ArrayView<int> term_ids_;
+    ArrayView<double> term_freqs_;
+};
+
+// Прямой индекс: пары (term_id, TF) всех документов, по столбцам в двух общих массивах.
+// Документ адресуется плотным порядковым номером и занимает в массивах непрерывный участок.
+// Удалённые документы остаются в массивах, пока их не вытеснит CompactIfNeeded
+class ForwardIndex {
+public:
+    // term_freqs - пары (term_id, TF) без повторов term_id в любом порядке
+    void AddDocument(int ordinal, std::vector<std::pair<int, double>> term_freqs);
+    // Слова документа остаются доступны до CompactIfNeeded
+    void RemoveDocument(int ordinal);
+    // Пересобирает массивы без удалённых документов, если те занимают не меньше половины
+    void CompactIfNeeded();
+
+    bool Contains(int ordinal) const;
+    // Пустые массивы, если документа нет
+    ArrayView<int> GetTermIds(int ordinal) const;
+    ArrayView<double> GetTermFreqs(int ordinal) const;
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Entry {
+        uint64_t offset = 0;
+        uint32_t size = 0;
+        bool is_present = false;
+        bool is_removed = false;
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<int> term_ids_;
+    std::vector<double> term_freqs_;
+    size_t removed_size_ = 0;
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+// Перемешивание splitmix64: из одного хеша получает независимые на вид значения
+inline uint64_t MixHash(uint64_t hash) {
+    hash += 0x9E3779B97F4A7C15;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EB;
+    return hash ^ (hash >> 31);
+}
@@ -0,0 +1,176 @@
+#include "index_segment.h"
+
+using namespace std;
+
+IndexSegment::IndexSegment(PostingFormat format)
+: format_(format)
+{
+}
+
+IndexSegment::IndexSegment(PostingFormat format, vector<int> document_ids, unordered_map<int, vector<Posting>> postings)
+: format_(format)
+, document_ids_(move(document_ids))
+{
+    sort(document_ids_.begin(), document_ids_.end());
+    ResetDeleted();
+    postings_.reserve(postings.size());
+    for (auto& [term_id, term_postings] : postings) {
+        sort(term_postings.begin(), term_postings.end(), [](const Posting& lhs, const Posting& rhs) {
+            return lhs.document_id < rhs.document_id;
+        });
+        postings_.emplace(term_id, PostingList(format_, move(term_postings)));
+    }
+}
+
+void IndexSegment::AddDocument(int document_id, const vector<pair<int, double>>& term_freqs) {
+    if (document_ids_.empty()) {
+        first_document_id_ = document_id;
+    } else if (document_id < first_document_id_) {
+        deleted_.insert(deleted_.begin(), first_document_id_ - document_id, false);
+        first_document_id_ = document_id;
+    }
+    if (static_cast<size_t>(document_id - first_document_id_) >= deleted_.size()) {
+        deleted_.resize(document_id - first_document_id_ + 1, false);
+    }
+    document_ids_.insert(lower_bound(document_ids_.begin(), document_ids_.end(), document_id), document_id);
+    for (const auto& [term_id, term_freq] : term_freqs) {
+        postings_.try_emplace(term_id, format_).first->second.Insert(document_id, term_freq);
+    }
+}
+
+bool IndexSegment::MarkDeleted(int document_id) {
+    if (FindDocument(document_id) == document_ids_.size() || IsDeleted(document_id)) {
+        return false;
+    }
+    deleted_[document_id - first_document_id_] = true;
+    ++deleted_count_;
+    return true;
+}
+
+bool IndexSegment::Contains(int document_id) const {
+    return FindDocument(document_id) != document_ids_.size() && !IsDeleted(document_id);
+}
+
+const PostingList* IndexSegment::FindPostings(int term_id) const {
+    const auto it = postings_.find(term_id);
+    return it == postings_.end() ? nullptr : &it->second;
+}
+
+const vector<int>& IndexSegment::GetDocumentIds() const {
+    return document_ids_;
+}
+
+const vector<bool>& IndexSegment::GetDeleted() const {
+    return deleted_;
+}
+
+int IndexSegment::GetFirstDocumentId() const {
+    return first_document_id_;
+}
+
+size_t IndexSegment::GetDocumentCount() const {
+    return document_ids_.size();
+}
+
+size_t IndexSegment::GetDeletedCount() const {
+    return deleted_count_;
+}
+
+size_t IndexSegment::GetLiveDocumentCount() const {
+    return document_ids_.size() - deleted_count_;
+}
+
+PostingFormat IndexSegment::GetFormat() const {
+    return format_;
+}
+
+void IndexSegment::SetFormat(PostingFormat format) {
+    format_ = format;
+    for (auto& [_, postings] : postings_) {
+        postings.SetFormat(format);
+    }
+}
+
+size_t IndexSegment::GetMemoryUsage() const {
+    size_t memory = document_ids_.capacity() * sizeof(int) + deleted_.capacity() / 8;
+    for (const auto& [_, postings] : postings_) {
+        memory += postings.GetMemoryUsage();
+    }
+    return memory;
+}
+
+void IndexSegment::ResetDeleted() {
+    deleted_.clear();
+    deleted_count_ = 0;
+    if (!document_ids_.empty()) {
+        first_document_id_ = document_ids_.front();
+        deleted_.resize(document_ids_.back() - first_document_id_ + 1, false);
+    }
+}
+
+IndexSegment IndexSegment::Merge(const vector<const IndexSegment*>& sources, const vector<vector<bool>>& deleted,
+                                 PostingFormat format) {
+    vector<int> document_ids;
+    unordered_map<int, vector<Posting>> postings;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const IndexSegment& source = *sources[i];
+        const auto is_deleted = [&](int document_id) {
+            return deleted[i][document_id - source.first_document_id_];
+        };
+        for (const int document_id : source.document_ids_) {
+            if (!is_deleted(document_id)) {
+                document_ids.push_back(document_id);
+            }
+        }
+        const bool has_deleted = find(deleted[i].begin(), deleted[i].end(), true) != deleted[i].end();
+        for (const auto& [term_id, term_postings] : source.postings_) {
+            vector<Posting>* merged_postings = nullptr;
+            term_postings.ForEach([&](const Posting& posting) {
+                if (has_deleted && is_deleted(posting.document_id)) {
+                    return;
+                }
+                // Слова, оставшиеся только у удалённых документов, в новый сегмент не попадают
+                if (merged_postings == nullptr) {
+                    merged_postings = &postings[term_id];
+                }
+                merged_postings->push_back(posting);
+            });
+        }
+    }
+    return IndexSegment(format, move(document_ids), move(postings));
+}
+
+void IndexSegment::Save(SnapshotWriter& writer) const {
+    writer.WriteValue<uint64_t>(document_ids_.size());
+    writer.WriteArray(document_ids_.data(), document_ids_.size());
+    vector<int> deleted_ids;
+    for (const int document_id : document_ids_) {
+        if (IsDeleted(document_id)) {
+            deleted_ids.push_back(document_id);
+        }
+    }
+    writer.WriteValue<uint64_t>(deleted_ids.size());
+    writer.WriteArray(deleted_ids.data(), deleted_ids.size());
+    writer.WriteValue<uint64_t>(postings_.size());
+    for (const auto& [term_id, postings] : postings_) {
+        writer.WriteValue(term_id);
+        postings.Save(writer);
+    }
+}
+
+IndexSegment IndexSegment::Load(SnapshotReader& reader, PostingFormat format) {
+    IndexSegment segment(format);
+    const auto document_ids = reader.ReadArray<int>(reader.ReadValue<uint64_t>());
+    segment.document_ids_.assign(document_ids.begin(), document_ids.end());
+    segment.ResetDeleted();
+    for (const int document_id : reader.ReadArray<int>(reader.ReadValue<uint64_t>())) {
+        segment.MarkDeleted(document_id);
+    }
+    const auto term_count = reader.ReadValue<uint64_t>();
+    segment.postings_.reserve(term_count);
+    for (size_t i = 0; i < term_count; ++i) {
+        const auto term_id = reader.ReadValue<int>();
+        segment.postings_.emplace(term_id, PostingList::Load(reader, format));
+    }
+    return segment;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "posting_list.h"
+#include "snapshot_io.h"
+
+// Сегмент индекса: списки словопозиций части документов (по term_id) и карта удалённых среди них.
+// Удаление только отмечает документ в карте; словопозиции удалённых документов остаются
+// в списках до слияния сегмента и пропускаются при поиске
+class IndexSegment {
+public:
+    explicit IndexSegment(PostingFormat format);
+    // Сегмент из готовых словопозиций; списки могут быть не отсортированы
+    IndexSegment(PostingFormat format, std::vector<int> document_ids, std::unordered_map<int, std::vector<Posting>> postings);
+
+    // term_freqs - пары (term_id, TF) документа
+    void AddDocument(int document_id, const std::vector<std::pair<int, double>>& term_freqs);
+    // false, если живого документа с таким id в сегменте нет
+    bool MarkDeleted(int document_id);
+
+    bool Contains(int document_id) const;
+    // Удалён ли документ; для id вне сегмента - false. Без поиска: карта удалений индексируется самим id
+    bool IsDeleted(int document_id) const;
+
+    // nullptr, если слово в сегменте не встречается
+    const PostingList* FindPostings(int term_id) const;
+
+    const std::vector<int>& GetDocumentIds() const;
+    // Карта удалений: бит i относится к id GetFirstDocumentId() + i
+    const std::vector<bool>& GetDeleted() const;
+    int GetFirstDocumentId() const;
+    size_t GetDocumentCount() const;
+    size_t GetDeletedCount() const;
+    size_t GetLiveDocumentCount() const;
+
+    PostingFormat GetFormat() const;
+    void SetFormat(PostingFormat format);
+    size_t GetMemoryUsage() const;
+
+    // Новый сегмент из документов sources, не отмеченных в deleted (по копии GetDeleted на источник)
+    static IndexSegment Merge(const std::vector<const IndexSegment*>& sources, const std::vector<std::vector<bool>>& deleted,
+                              PostingFormat format);
+
+    void Save(SnapshotWriter& writer) const;
+    static IndexSegment Load(SnapshotReader& reader, PostingFormat format);
+
+private:
+    PostingFormat format_;
+    // Все документы сегмента по возрастанию id
+    std::vector<int> document_ids_;
+    // Карта удалений по id от first_document_id_ до последнего id сегмента. id - порядковые
+    // номера документов сервера, поэтому пропусков в диапазоне немного
+    int first_document_id_ = 0;
+    std::vector<bool> deleted_;
+    size_t deleted_count_ = 0;
+    std::unordered_map<int, PostingList> postings_;
+
+    // Позиция документа в document_ids_ или document_ids_.size()
+    size_t FindDocument(int document_id) const;
+    // Пустая карта удалений по диапазону id из document_ids_
+    void ResetDeleted();
+};
+
+inline size_t IndexSegment::FindDocument(int document_id) const {
+    const auto it = std::lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    return it != document_ids_.end() && *it == document_id ? it - document_ids_.begin() : document_ids_.size();
+}
+
+inline bool IndexSegment::IsDeleted(int document_id) const {
+    // Отрицательная разность при приведении становится больше размера карты
+    const size_t index = static_cast<size_t>(document_id) - static_cast<size_t>(first_document_id_);
+    return deleted_count_ != 0 && index < deleted_.size() && deleted_[index];
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct CacheStatistics {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t size = 0;
+
+    double GetHitRate() const {
+        return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+    }
+};
+
+// Потокобезопасный кеш на capacity строковых ключей, вытесняет давно не использованные (LRU).
+// Значения неизменяемы и отдаются через shared_ptr: найденное значение остаётся живым,
+// даже если его тут же вытеснят. Поиск по string_view не выделяет память
+template <typename Value>
+class LruCache {
+public:
+    explicit LruCache(size_t capacity = 0)
+    : capacity_(capacity) {
+    }
+
+    // Значение по ключу или nullptr. Значение, для которого is_valid(value) == false, удаляется
+    // и считается промахом
+    template <typename Validator>
+    std::shared_ptr<const Value> Find(std::string_view key, Validator is_valid) {
+        std::lock_guard lock(mutex_);
+        const auto it = index_.find(key);
+        if (it == index_.end()) {
+            ++misses_;
+            return nullptr;
+        }
+        if (!is_valid(*it->second->second)) {
+            entries_.erase(it->second);
+            index_.erase(it);
+            ++misses_;
+            return nullptr;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        ++hits_;
+        return it->second->second;
+    }
+
+    std::shared_ptr<const Value> Find(std::string_view key) {
+        return Find(key, [](const Value&) {
+            return true;
+        });
+    }
+
+    void Insert(std::string_view key, std::shared_ptr<const Value> value) {
+        std::lock_guard lock(mutex_);
+        if (const auto it = index_.find(key); it != index_.end()) {
+            it->second->second = std::move(value);
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return;
+        }
+        if (capacity_ == 0) {
+            return;
+        }
+        entries_.emplace_front(std::string(key), std::move(value));
+        index_.emplace(entries_.front().first, entries_.begin());
+        EvictExcess();
+    }
+
+    void SetCapacity(size_t capacity) {
+        std::lock_guard lock(mutex_);
+        capacity_ = capacity;
+        EvictExcess();
+    }
+
+    void Clear() {
+        std::lock_guard lock(mutex_);
+        index_.clear();
+        entries_.clear();
+    }
+
+    CacheStatistics GetStatistics() const {
+        std::lock_guard lock(mutex_);
+        return {hits_, misses_, entries_.size()};
+    }
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const Value>>;
+
+    mutable std::mutex mutex_;
+    size_t capacity_;
+    // Сначала самые свежие. Ключи index_ указывают на строки в узлах списка
+    std::list<Entry> entries_;
+    std::unordered_map<std::string_view, typename std::list<Entry>::iterator> index_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    void EvictExcess() {
+        while (entries_.size() > capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+    }
+};
+
+// LruCache, разбитый на части по хешу ключа: потоки, ищущие разные ключи, реже ждут друг друга
+template <typename Value>
+class ShardedLruCache {
+public:
+    // capacity делится между частями поровну, остаток - по одному первым частям. Суммарно
+    // в кеше не больше capacity значений; при capacity меньше числа частей часть из них пустует
+    ShardedLruCache(size_t shard_count, size_t capacity)
+    : shards_(std::max<size_t>(shard_count, 1)) {
+        SetCapacity(capacity);
+    }
+
+    template <typename Validator>
+    std::shared_ptr<const Value> Find(std::string_view key, Validator is_valid) {
+        return GetShard(key).Find(key, is_valid);
+    }
+
+    void Insert(std::string_view key, std::shared_ptr<const Value> value) {
+        GetShard(key).Insert(key, std::move(value));
+    }
+
+    void SetCapacity(size_t capacity) {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            shards_[i].SetCapacity(capacity / shards_.size() + (i < capacity % shards_.size() ? 1 : 0));
+        }
+    }
+
+    void Clear() {
+        for (auto& shard : shards_) {
+            shard.Clear();
+        }
+    }
+
+    CacheStatistics GetStatistics() const {
+        CacheStatistics statistics;
+        for (const auto& shard : shards_) {
+            const CacheStatistics shard_statistics = shard.GetStatistics();
+            statistics.hits += shard_statistics.hits;
+            statistics.misses += shard_statistics.misses;
+            statistics.size += shard_statistics.size;
+        }
+        return statistics;
+    }
+
+private:
+    std::vector<LruCache<Value>> shards_;
+
+    LruCache<Value>& GetShard(std::string_view key) {
+        return shards_[std::hash<std::string_view>{}(key) % shards_.size()];
+    }
+};
@@ -1,4 +1,6 @@
 #include "search_server.h"
+#include "search_server_tests.h"
+#include "benchmarks.h"
 
 #include <iostream>
 #include <random>
@@ -7,7 +9,39 @@
 
 using namespace std;
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Замеры производительности: ./search_server --benchmark [document_count].
+    // Выделения памяти в запросах считаются, только если программа собрана с -DSEARCH_SERVER_BENCHMARKS
+    if (argc > 1 && argv[1] == "--benchmark"s) {
+        const int document_count = argc > 2 ? stoi(argv[2]) : 1'000'000;
+        BenchmarkIndexLayout(document_count);
+        BenchmarkPostingCompression(document_count);
+        BenchmarkTopDocumentSelection(document_count);
+        BenchmarkDynamicPruning(document_count);
+        BenchmarkMinusWords(document_count);
+        BenchmarkParallelScoring(document_count);
+        BenchmarkQueryCache(document_count);
+        BenchmarkResultCache(document_count);
+        BenchmarkTokenizer(document_count);
+        BenchmarkStopWords(document_count);
+        BenchmarkQueryAllocations(document_count);
+        BenchmarkMatchDocuments(document_count);
+        BenchmarkIngestion(document_count);
+        BenchmarkSnapshot(document_count);
+        BenchmarkLiveUpdates(document_count);
+        BenchmarkChurn(document_count);
+        BenchmarkRemoveDuplicates(document_count);
+        BenchmarkNearDuplicates(document_count);
+        BenchmarkConcurrentUpdates(document_count);
+        return 0;
+    }
+    // Проверки поиска: ./search_server --test
+    if (argc > 1 && argv[1] == "--test"s) {
+        TestSearchServer();
+        cout << "All tests passed"s << endl;
+        return 0;
+    }
+
     SearchServer search_server("and with"s);
 
     int id = 0;
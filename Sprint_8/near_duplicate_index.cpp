@@ -0,0 +1,121 @@
+#include "near_duplicate_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+#include "hash_mix.h"
+
+using namespace std;
+
+NearDuplicateIndex::NearDuplicateIndex(double jaccard_threshold)
+: jaccard_threshold_(jaccard_threshold)
+, rows_per_band_(1)
+{
+    if (!(jaccard_threshold > 0 && jaccard_threshold <= 1)) {
+        throw invalid_argument("Jaccard threshold must be in (0, 1]");
+    }
+    // Пара с коэффициентом s совпадает хотя бы в одной из b полос по r строк с вероятностью
+    // 1 - (1 - s^r)^b; резкий рост этой вероятности приходится на s около (1/b)^(1/r).
+    // Берём самые длинные полосы, у которых этот перегиб не выше порога
+    for (size_t rows = 2; rows <= SIGNATURE_SIZE; rows *= 2) {
+        const double band_count = static_cast<double>(SIGNATURE_SIZE / rows);
+        if (pow(1 / band_count, 1 / static_cast<double>(rows)) > jaccard_threshold) {
+            break;
+        }
+        rows_per_band_ = rows;
+    }
+    band_buckets_.resize(SIGNATURE_SIZE / rows_per_band_);
+}
+
+double NearDuplicateIndex::GetJaccardThreshold() const {
+    return jaccard_threshold_;
+}
+
+void NearDuplicateIndex::AddDocument(int document_id, const WordFrequencies& word_freqs) {
+    if (word_freqs.empty() || document_bands_.count(document_id)) {
+        return;
+    }
+    auto band_keys = ComputeBandKeys(word_freqs);
+    for (size_t band = 0; band < band_keys.size(); ++band) {
+        band_buckets_[band][band_keys[band]].push_back(document_id);
+    }
+    document_bands_.emplace(document_id, move(band_keys));
+}
+
+void NearDuplicateIndex::RemoveDocument(int document_id) {
+    const auto it = document_bands_.find(document_id);
+    if (it == document_bands_.end()) {
+        return;
+    }
+    for (size_t band = 0; band < it->second.size(); ++band) {
+        const auto bucket = band_buckets_[band].find(it->second[band]);
+        auto& document_ids = bucket->second;
+        document_ids.erase(find(document_ids.begin(), document_ids.end(), document_id));
+        if (document_ids.empty()) {
+            band_buckets_[band].erase(bucket);
+        }
+    }
+    document_bands_.erase(it);
+}
+
+vector<int> NearDuplicateIndex::FindCandidates(int document_id) const {
+    vector<int> candidates;
+    const auto it = document_bands_.find(document_id);
+    if (it == document_bands_.end()) {
+        return candidates;
+    }
+    for (size_t band = 0; band < it->second.size(); ++band) {
+        const auto& document_ids = band_buckets_[band].at(it->second[band]);
+        candidates.insert(candidates.end(), document_ids.begin(), document_ids.end());
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+    candidates.erase(find(candidates.begin(), candidates.end(), document_id));
+    return candidates;
+}
+
+vector<uint64_t> NearDuplicateIndex::ComputeBandKeys(const WordFrequencies& word_freqs) const {
+    // i-я хеш-функция подписи - перемешанное h1 + i * h2 от хеша слова
+    vector<uint64_t> signature(SIGNATURE_SIZE, numeric_limits<uint64_t>::max());
+    for (const auto& [word, _] : word_freqs) {
+        const uint64_t first_hash = MixHash(hash<string_view>{}(word));
+        const uint64_t second_hash = MixHash(first_hash) | 1;
+        for (size_t i = 0; i < SIGNATURE_SIZE; ++i) {
+            signature[i] = min(signature[i], MixHash(first_hash + i * second_hash));
+        }
+    }
+    vector<uint64_t> band_keys(SIGNATURE_SIZE / rows_per_band_);
+    for (size_t band = 0; band < band_keys.size(); ++band) {
+        uint64_t key = 0;
+        for (size_t row = band * rows_per_band_; row < (band + 1) * rows_per_band_; ++row) {
+            key = MixHash(key ^ signature[row]);
+        }
+        band_keys[band] = key;
+    }
+    return band_keys;
+}
+
+double ComputeJaccardSimilarity(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1;
+    }
+    // У живых документов одно слово - один term_id, поэтому наборы сравниваются по term_id
+    const auto lhs_term_ids = lhs.GetTermIds();
+    const auto rhs_term_ids = rhs.GetTermIds();
+    size_t common_count = 0;
+    for (auto lhs_it = lhs_term_ids.begin(), rhs_it = rhs_term_ids.begin(); lhs_it != lhs_term_ids.end() && rhs_it != rhs_term_ids.end();) {
+        if (*lhs_it < *rhs_it) {
+            ++lhs_it;
+        } else if (*rhs_it < *lhs_it) {
+            ++rhs_it;
+        } else {
+            ++common_count;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return static_cast<double>(common_count) / static_cast<double>(lhs.size() + rhs.size() - common_count);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "forward_index.h"
+
+// Поиск кандидатов в почти одинаковые документы. Для набора слов документа считается
+// MinHash-подпись: доля совпадающих позиций двух подписей оценивает коэффициент Жаккара наборов.
+// Подпись режется на полосы (LSH); документы с совпавшей хотя бы одной полосой становятся
+// кандидатами. Число строк в полосе подбирается по порогу так, чтобы пары с коэффициентом
+// выше порога почти наверняка совпали в какой-нибудь полосе
+class NearDuplicateIndex {
+public:
+    static constexpr size_t SIGNATURE_SIZE = 128;
+
+    // jaccard_threshold в (0, 1]
+    explicit NearDuplicateIndex(double jaccard_threshold);
+
+    double GetJaccardThreshold() const;
+
+    void AddDocument(int document_id, const WordFrequencies& word_freqs);
+    void RemoveDocument(int document_id);
+
+    // Документы, у которых с document_id совпала хотя бы одна полоса, по возрастанию id.
+    // Среди них бывают и ложные кандидаты: коэффициент Жаккара нужно проверить
+    std::vector<int> FindCandidates(int document_id) const;
+
+private:
+    double jaccard_threshold_;
+    size_t rows_per_band_;
+    // Ключи полос каждого документа, чтобы удалять его из корзин
+    std::unordered_map<int, std::vector<uint64_t>> document_bands_;
+    // По полосе: ключ полосы -> документы
+    std::vector<std::unordered_map<uint64_t, std::vector<int>>> band_buckets_;
+
+    std::vector<uint64_t> ComputeBandKeys(const WordFrequencies& word_freqs) const;
+};
+
+// Коэффициент Жаккара наборов слов двух документов: |A ∩ B| / |A ∪ B|
+double ComputeJaccardSimilarity(const WordFrequencies& lhs, const WordFrequencies& rhs);
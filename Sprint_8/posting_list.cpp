@@ -0,0 +1,301 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+template <typename PostingIterator>
+PostingIterator LowerBoundDocument(PostingIterator first, PostingIterator last, int document_id) {
+    return lower_bound(first, last, document_id, [](const Posting& posting, int id) {
+        return posting.document_id < id;
+    });
+}
+
+// Как LowerBoundDocument, но сначала шагами 1, 2, 4... от first: цена зависит от расстояния
+// до искомой словопозиции, а не от длины остатка списка
+const Posting* GallopToDocument(const Posting* first, const Posting* last, int document_id) {
+    size_t step = 1;
+    while (step < static_cast<size_t>(last - first) && first[step].document_id < document_id) {
+        first += step;
+        step *= 2;
+    }
+    return LowerBoundDocument(first, first + min(step + 1, static_cast<size_t>(last - first)), document_id);
+}
+
+// TF в том виде, в каком её хранит сжатый блок
+double QuantizeTermFreq(double term_freq) {
+    return lround(min(term_freq, 1.0) * PostingList::TERM_FREQ_SCALE) / PostingList::TERM_FREQ_SCALE;
+}
+
+void WriteVarint(vector<uint8_t>& output, uint32_t value) {
+    while (value >= 0x80) {
+        output.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t ReadVarint(const uint8_t*& input) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (*input & 0x80) {
+        value |= static_cast<uint32_t>(*input++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= static_cast<uint32_t>(*input++) << shift;
+    return value;
+}
+}
+
+PostingList::PostingList(PostingFormat format)
+: format_(format)
+{
+}
+
+PostingList::PostingList(PostingFormat format, vector<Posting> postings)
+: format_(format)
+{
+    Rebuild(move(postings));
+}
+
+void PostingList::Insert(int document_id, double term_freq) {
+    Detach();
+    // Хвост хранит TF уже квантованной: иначе у словопозиции до и после упаковки в блок
+    // была бы разная TF, и порядок выдачи зависел бы от момента упаковки
+    if (format_ == PostingFormat::COMPRESSED) {
+        term_freq = QuantizeTermFreq(term_freq);
+    }
+    max_term_freq_ = max(max_term_freq_, term_freq);
+    const bool is_last = empty() || (plain_.empty() ? blocks_.back().last_document_id : plain_.back().document_id) < document_id;
+    if (!is_last) {
+        if (format_ == PostingFormat::PLAIN) {
+            plain_.insert(LowerBoundDocument(plain_.begin(), plain_.end(), document_id), {document_id, term_freq});
+            SetSize(size_ + 1);
+        } else {
+            auto postings = DecodeAll();
+            postings.insert(LowerBoundDocument(postings.begin(), postings.end(), document_id), {document_id, term_freq});
+            Rebuild(move(postings));
+        }
+        return;
+    }
+    plain_.push_back({document_id, term_freq});
+    SetSize(size_ + 1);
+    if (format_ == PostingFormat::COMPRESSED && plain_.size() == BLOCK_SIZE) {
+        EncodeBlock(plain_.data(), plain_.size());
+        plain_.clear();
+    }
+}
+
+void PostingList::Erase(int document_id) {
+    Detach();
+    const auto it = LowerBoundDocument(plain_.begin(), plain_.end(), document_id);
+    if (it != plain_.end() && it->document_id == document_id) {
+        plain_.erase(it);
+        SetSize(size_ - 1);
+        return;
+    }
+    if (format_ == PostingFormat::COMPRESSED && Contains(document_id)) {
+        auto postings = DecodeAll();
+        postings.erase(LowerBoundDocument(postings.begin(), postings.end(), document_id));
+        Rebuild(move(postings));
+    }
+}
+
+bool PostingList::Contains(int document_id) const {
+    const auto blocks = GetBlocks();
+    const auto block_it = lower_bound(blocks.begin(), blocks.end(), document_id, [](const BlockInfo& block, int id) {
+        return block.last_document_id < id;
+    });
+    if (block_it != blocks.end()) {
+        if (block_it->first_document_id > document_id) {
+            return false;
+        }
+        Posting block[BLOCK_SIZE];
+        const size_t count = DecodeBlock(*block_it, block);
+        const auto it = LowerBoundDocument(block, block + count, document_id);
+        return it != block + count && it->document_id == document_id;
+    }
+    const auto plain = GetPlain();
+    const auto it = LowerBoundDocument(plain.begin(), plain.end(), document_id);
+    return it != plain.end() && it->document_id == document_id;
+}
+
+size_t PostingList::size() const {
+    return size_;
+}
+
+bool PostingList::empty() const {
+    return size_ == 0;
+}
+
+int PostingList::SampleDocumentId(size_t index) const {
+    const auto blocks = GetBlocks();
+    const auto plain = GetPlain();
+    const size_t block_index = index / BLOCK_SIZE;
+    if (block_index < blocks.size()) {
+        return blocks[block_index].first_document_id;
+    }
+    const size_t packed_count = size_ - plain.size();
+    return plain[std::min(index - packed_count, plain.size() - 1)].document_id;
+}
+
+double PostingList::GetMaxTermFreq() const {
+    return max_term_freq_;
+}
+
+PostingFormat PostingList::GetFormat() const {
+    return format_;
+}
+
+void PostingList::SetFormat(PostingFormat format) {
+    if (format_ == format) {
+        return;
+    }
+    auto postings = DecodeAll();
+    format_ = format;
+    Rebuild(move(postings));
+}
+
+size_t PostingList::GetMemoryUsage() const {
+    return plain_.capacity() * sizeof(Posting) + blocks_.capacity() * sizeof(BlockInfo) + data_.capacity();
+}
+
+void PostingList::Save(SnapshotWriter& writer) const {
+    writer.WriteValue<uint64_t>(size_);
+    writer.WriteValue(max_term_freq_);
+    const auto plain = GetPlain();
+    const auto blocks = GetBlocks();
+    const auto data = GetData();
+    writer.WriteValue<uint64_t>(plain.size());
+    writer.WriteArray(plain.data(), plain.size());
+    writer.WriteValue<uint64_t>(blocks.size());
+    writer.WriteArray(blocks.data(), blocks.size());
+    writer.WriteValue<uint64_t>(data.size());
+    writer.WriteArray(data.data(), data.size());
+}
+
+PostingList PostingList::Load(SnapshotReader& reader, PostingFormat format) {
+    PostingList postings(format);
+    const auto size = reader.ReadValue<uint64_t>();
+    postings.max_term_freq_ = reader.ReadValue<double>();
+    MappedData mapped;
+    mapped.plain = reader.ReadArray<Posting>(reader.ReadValue<uint64_t>());
+    mapped.blocks = reader.ReadArray<BlockInfo>(reader.ReadValue<uint64_t>());
+    mapped.data = reader.ReadArray<uint8_t>(reader.ReadValue<uint64_t>());
+    postings.mapped_ = mapped;
+    postings.SetSize(size);
+    return postings;
+}
+
+void PostingList::Detach() {
+    if (!mapped_) {
+        return;
+    }
+    plain_.assign(mapped_->plain.begin(), mapped_->plain.end());
+    blocks_.assign(mapped_->blocks.begin(), mapped_->blocks.end());
+    data_.assign(mapped_->data.begin(), mapped_->data.end());
+    mapped_.reset();
+}
+
+size_t PostingList::DecodeBlock(const BlockInfo& block, Posting* output) const {
+    const uint8_t* input = GetData().data() + block.offset;
+    int document_id = block.first_document_id;
+    output[0].document_id = document_id;
+    for (uint32_t i = 1; i < block.count; ++i) {
+        document_id += static_cast<int>(ReadVarint(input));
+        output[i].document_id = document_id;
+    }
+    for (uint32_t i = 0; i < block.count; ++i) {
+        const uint32_t quantized = input[0] | (static_cast<uint32_t>(input[1]) << 8);
+        output[i].term_freq = quantized / TERM_FREQ_SCALE;
+        input += 2;
+    }
+    return block.count;
+}
+
+void PostingList::EncodeBlock(const Posting* postings, size_t count) {
+    blocks_.push_back({postings[0].document_id, postings[count - 1].document_id,
+                       static_cast<uint32_t>(data_.size()), static_cast<uint32_t>(count)});
+    for (size_t i = 1; i < count; ++i) {
+        WriteVarint(data_, static_cast<uint32_t>(postings[i].document_id - postings[i - 1].document_id));
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const auto quantized = static_cast<uint32_t>(lround(min(postings[i].term_freq, 1.0) * TERM_FREQ_SCALE));
+        data_.push_back(static_cast<uint8_t>(quantized));
+        data_.push_back(static_cast<uint8_t>(quantized >> 8));
+    }
+}
+
+void PostingList::SetSize(size_t size) {
+    size_ = size;
+}
+
+vector<Posting> PostingList::DecodeAll() const {
+    vector<Posting> postings;
+    postings.reserve(size_);
+    ForEach([&postings](const Posting& posting) {
+        postings.push_back(posting);
+    });
+    return postings;
+}
+
+void PostingList::Rebuild(vector<Posting> postings) {
+    mapped_.reset();
+    SetSize(postings.size());
+    max_term_freq_ = 0.0;
+    for (Posting& posting : postings) {
+        if (format_ == PostingFormat::COMPRESSED) {
+            posting.term_freq = QuantizeTermFreq(posting.term_freq);
+        }
+        max_term_freq_ = max(max_term_freq_, posting.term_freq);
+    }
+    blocks_.clear();
+    data_.clear();
+    if (format_ == PostingFormat::PLAIN) {
+        plain_ = move(postings);
+        return;
+    }
+    // Последний блок может быть неполным: новые словопозиции всё равно пойдут в хвост
+    for (size_t first = 0; first < postings.size(); first += BLOCK_SIZE) {
+        EncodeBlock(postings.data() + first, min(BLOCK_SIZE, postings.size() - first));
+    }
+    plain_.clear();
+    blocks_.shrink_to_fit();
+    data_.shrink_to_fit();
+    plain_.shrink_to_fit();
+}
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+: postings_(&postings)
+, blocks_(postings.GetBlocks())
+, plain_(postings.GetPlain())
+{
+    LoadBlock(0);
+}
+
+void PostingList::Cursor::SkipTo(int document_id) {
+    if (IsEnd() || GetDocumentId() >= document_id) {
+        return;
+    }
+    if (block_index_ < blocks_.size() && blocks_[block_index_].last_document_id < document_id) {
+        const auto block_it = lower_bound(blocks_.begin() + block_index_ + 1, blocks_.end(), document_id,
+                                          [](const BlockInfo& block, int id) {
+                                              return block.last_document_id < id;
+                                          });
+        LoadBlock(block_it - blocks_.begin());
+    }
+    const Posting* data = GetData();
+    position_ = GallopToDocument(data + position_, data + count_, document_id) - data;
+}
+
+void PostingList::Cursor::LoadBlock(size_t block_index) {
+    block_index_ = block_index;
+    position_ = 0;
+    if (block_index_ < blocks_.size()) {
+        count_ = postings_->DecodeBlock(blocks_[block_index_], buffer_.data());
+    } else {
+        count_ = plain_.size();
+    }
+}
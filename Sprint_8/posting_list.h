@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "array_view.h"
+#include "snapshot_io.h"
+
+enum class PostingFormat {
+    PLAIN,
+    COMPRESSED,
+};
+
+struct Posting {
+    int document_id;
+    double term_freq;
+};
+
+// Список словопозиций слова, отсортированный по document_id.
+// PLAIN хранит пары как есть. COMPRESSED делит список на блоки по BLOCK_SIZE:
+// id кодируются разностями в varint, TF квантуются в uint16_t (погрешность не больше 1/131070).
+// Новые словопозиции с наибольшим id копятся в несжатом хвосте, пока не наберётся блок;
+// TF в хвосте уже квантована, поэтому упаковка в блок её не меняет.
+// Вставка в середину и удаление из сжатой части перекодируют список целиком
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+    static constexpr double TERM_FREQ_SCALE = 65535.0;
+
+    class Cursor;
+
+    explicit PostingList(PostingFormat format = PostingFormat::PLAIN);
+    // Список из готовых словопозиций, отсортированных по document_id
+    PostingList(PostingFormat format, std::vector<Posting> postings);
+
+    void Insert(int document_id, double term_freq);
+    void Erase(int document_id);
+    bool Contains(int document_id) const;
+
+    size_t size() const;
+    bool empty() const;
+
+    // id документа примерно на позиции index (в сжатой части - начало блока),
+    // чтобы делить список на равные по объёму диапазоны id
+    int SampleDocumentId(size_t index) const;
+
+    // Верхняя оценка TF по списку, для динамического отсечения при ранжировании
+    double GetMaxTermFreq() const;
+
+    PostingFormat GetFormat() const;
+    void SetFormat(PostingFormat format);
+    size_t GetMemoryUsage() const;
+
+    void Save(SnapshotWriter& writer) const;
+    // Список читает словопозиции прямо из буфера снимка, пока его не изменят
+    static PostingList Load(SnapshotReader& reader, PostingFormat format);
+
+    // Обходит словопозиции по возрастанию document_id, сжатые блоки декодируются по одному
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    struct BlockInfo {
+        int first_document_id;
+        int last_document_id;
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // Данные из снимка индекса; перед первым изменением копируются в собственные векторы
+    struct MappedData {
+        ArrayView<Posting> plain;
+        ArrayView<BlockInfo> blocks;
+        ArrayView<uint8_t> data;
+    };
+
+    PostingFormat format_;
+    // В PLAIN - весь список, в COMPRESSED - хвост, ещё не упакованный в блок
+    std::vector<Posting> plain_;
+    std::vector<BlockInfo> blocks_;
+    std::vector<uint8_t> data_;
+    std::optional<MappedData> mapped_;
+    size_t size_ = 0;
+    double max_term_freq_ = 0.0;
+
+    ArrayView<Posting> GetPlain() const;
+    ArrayView<BlockInfo> GetBlocks() const;
+    ArrayView<uint8_t> GetData() const;
+    void Detach();
+
+    size_t DecodeBlock(const BlockInfo& block, Posting* output) const;
+    void EncodeBlock(const Posting* postings, size_t count);
+    std::vector<Posting> DecodeAll() const;
+    void SetSize(size_t size);
+    void Rebuild(std::vector<Posting> postings);
+};
+
+// Последовательное чтение списка с пропуском вперёд (SkipTo) по таблице блоков
+class PostingList::Cursor {
+public:
+    explicit Cursor(const PostingList& postings);
+
+    bool IsEnd() const;
+    int GetDocumentId() const;
+    double GetTermFreq() const;
+
+    void Next();
+    // Переходит к первой словопозиции с id не меньше document_id
+    void SkipTo(int document_id);
+
+private:
+    const PostingList* postings_;
+    ArrayView<BlockInfo> blocks_;
+    ArrayView<Posting> plain_;
+    // Номер текущего блока; blocks_.size() означает несжатый хвост
+    size_t block_index_ = 0;
+    size_t position_ = 0;
+    size_t count_ = 0;
+    std::array<Posting, BLOCK_SIZE> buffer_;
+
+    const Posting* GetData() const;
+    void LoadBlock(size_t block_index);
+};
+
+inline bool PostingList::Cursor::IsEnd() const {
+    return position_ == count_;
+}
+
+inline int PostingList::Cursor::GetDocumentId() const {
+    return GetData()[position_].document_id;
+}
+
+inline double PostingList::Cursor::GetTermFreq() const {
+    return GetData()[position_].term_freq;
+}
+
+inline void PostingList::Cursor::Next() {
+    ++position_;
+    if (position_ == count_ && block_index_ < blocks_.size()) {
+        LoadBlock(block_index_ + 1);
+    }
+}
+
+inline const Posting* PostingList::Cursor::GetData() const {
+    return block_index_ < blocks_.size() ? buffer_.data() : plain_.data();
+}
+
+template <typename Function>
+void PostingList::ForEach(Function function) const {
+    const auto blocks = GetBlocks();
+    if (!blocks.empty()) {
+        Posting block[BLOCK_SIZE];
+        for (const BlockInfo& info : blocks) {
+            const size_t count = DecodeBlock(info, block);
+            for (size_t i = 0; i < count; ++i) {
+                function(block[i]);
+            }
+        }
+    }
+    for (const Posting& posting : GetPlain()) {
+        function(posting);
+    }
+}
+
+inline ArrayView<Posting> PostingList::GetPlain() const {
+    return mapped_ ? mapped_->plain : ArrayView<Posting>(plain_);
+}
+
+inline ArrayView<PostingList::BlockInfo> PostingList::GetBlocks() const {
+    return mapped_ ? mapped_->blocks : ArrayView<BlockInfo>(blocks_);
+}
+
+inline ArrayView<uint8_t> PostingList::GetData() const {
+    return mapped_ ? mapped_->data : ArrayView<uint8_t>(data_);
+}
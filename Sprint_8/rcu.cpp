@@ -0,0 +1,95 @@
+#include "rcu.h"
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+// Слот читателя. Слоты не освобождаются: поток при выходе возвращает слот в общий список
+// для повторного использования, поэтому писатель может обходить список без блокировок
+struct alignas(64) ReaderSlot {
+    // 0 - поток вне секции чтения, иначе эпоха, в которой он вошёл
+    atomic<uint64_t> epoch{0};
+    atomic<bool> in_use{true};
+    ReaderSlot* next = nullptr;
+};
+
+atomic<ReaderSlot*> reader_slots{nullptr};
+atomic<uint64_t> global_epoch{1};
+const int SPIN_ATTEMPTS = 64;
+
+ReaderSlot* AcquireSlot() {
+    for (ReaderSlot* slot = reader_slots.load(); slot != nullptr; slot = slot->next) {
+        bool in_use = false;
+        if (slot->in_use.compare_exchange_strong(in_use, true)) {
+            return slot;
+        }
+    }
+    auto* slot = new ReaderSlot;
+    slot->next = reader_slots.load();
+    while (!reader_slots.compare_exchange_weak(slot->next, slot)) {
+    }
+    return slot;
+}
+
+struct ThreadReader {
+    ReaderSlot* slot = AcquireSlot();
+    int depth = 0;
+
+    ~ThreadReader() {
+        slot->in_use.store(false);
+    }
+};
+
+ThreadReader& GetThreadReader() {
+    thread_local ThreadReader reader;
+    return reader;
+}
+}
+
+RcuReadGuard::RcuReadGuard() {
+    ThreadReader& reader = GetThreadReader();
+    if (reader.depth++ == 0) {
+        // seq_cst: отметка в слоте должна стать видна писателю раньше, чем читатель загрузит указатель
+        reader.slot->epoch.store(global_epoch.load());
+    }
+}
+
+RcuReadGuard::~RcuReadGuard() {
+    ThreadReader& reader = GetThreadReader();
+    if (--reader.depth == 0) {
+        reader.slot->epoch.store(0, memory_order_release);
+    }
+}
+
+uint64_t RcuStartGracePeriod() {
+    // Читатели, вошедшие после увеличения эпохи, уже видят новую версию - их ждать не нужно
+    return global_epoch.fetch_add(1) + 1;
+}
+
+void RcuWaitForGracePeriod(uint64_t grace_period) {
+    if (GetThreadReader().depth != 0) {
+        throw logic_error("Waiting for RCU readers inside a read section would wait for itself");
+    }
+    for (ReaderSlot* slot = reader_slots.load(); slot != nullptr; slot = slot->next) {
+        for (int attempt = 0;; ++attempt) {
+            const uint64_t reader_epoch = slot->epoch.load();
+            if (reader_epoch == 0 || reader_epoch >= grace_period) {
+                break;
+            }
+            // Запрос читателя может идти долго: после нескольких попыток не отнимаем у него процессор
+            if (attempt < SPIN_ATTEMPTS) {
+                this_thread::yield();
+            } else {
+                this_thread::sleep_for(chrono::microseconds(50));
+            }
+        }
+    }
+}
+
+void RcuSynchronize() {
+    RcuWaitForGracePeriod(RcuStartGracePeriod());
+}
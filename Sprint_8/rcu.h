@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// RCU на эпохах. Читатель входит в секцию чтения (RcuReadGuard) без блокировок: отмечает
+// в своём слоте текущую эпоху. Писатель публикует новую версию данных атомарной заменой
+// указателя и вызывает RcuSynchronize, которая ждёт выхода всех читателей, вошедших
+// до публикации; после этого старую версию можно менять или удалять.
+// Ожидание можно отложить: RcuStartGracePeriod сразу после публикации, RcuWaitForGracePeriod -
+// когда старая версия действительно понадобится; к тому времени читатели обычно уже вышли.
+// Секции чтения могут быть вложенными. Ждать внутри секции чтения нельзя
+class RcuReadGuard {
+public:
+    RcuReadGuard();
+    ~RcuReadGuard();
+
+    RcuReadGuard(const RcuReadGuard&) = delete;
+    RcuReadGuard& operator=(const RcuReadGuard&) = delete;
+};
+
+// Возвращает отметку периода ожидания для читателей, вошедших до вызова
+uint64_t RcuStartGracePeriod();
+void RcuWaitForGracePeriod(uint64_t grace_period);
+void RcuSynchronize();
+
+// Указатель на версию данных, которую читают под RcuReadGuard
+template <typename Type>
+class RcuPointer {
+public:
+    explicit RcuPointer(std::unique_ptr<Type> value = nullptr)
+    : current_(value.release()) {
+    }
+
+    ~RcuPointer() {
+        delete current_.load();
+    }
+
+    RcuPointer(const RcuPointer&) = delete;
+    RcuPointer& operator=(const RcuPointer&) = delete;
+
+    // Читателю - только внутри RcuReadGuard; писателю - под его собственной блокировкой
+    Type* Get() const {
+        return current_.load();
+    }
+
+    // Заменяет версию и возвращает прежнюю. Удалять её можно только после RcuSynchronize,
+    // а ждать лучше, отпустив блокировки писателя: читатель может ждать их внутри секции чтения
+    std::unique_ptr<Type> Exchange(std::unique_ptr<Type> value) {
+        return std::unique_ptr<Type>(current_.exchange(value.release()));
+    }
+
+private:
+    std::atomic<Type*> current_;
+};
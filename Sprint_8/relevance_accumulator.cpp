@@ -0,0 +1,25 @@
+#include "relevance_accumulator.h"
+
+#include <algorithm>
+
+RelevanceAccumulator& RelevanceAccumulator::ForCurrentThread() {
+    thread_local RelevanceAccumulator accumulator;
+    return accumulator;
+}
+
+void RelevanceAccumulator::Reset(size_t document_count) {
+    for (const size_t ordinal : touched_) {
+        relevances_[ordinal] = 0.0;
+    }
+    touched_.clear();
+    if (scored_mark_ + 2 > MAX_SCORED_MARK) {
+        std::fill(marks_.begin(), marks_.end(), 0);
+        scored_mark_ = 1;
+    } else {
+        scored_mark_ += 2;
+    }
+    if (relevances_.size() < document_count) {
+        relevances_.resize(document_count, 0.0);
+        marks_.resize(document_count, 0);
+    }
+}
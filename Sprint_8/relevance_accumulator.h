@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Накопитель релевантности, индексированный порядковым номером документа.
+// Между запросами обнуляются только затронутые ячейки, поэтому после прогрева
+// подсчёт не выделяет память. Рассчитан на повторное использование в пределах потока
+class RelevanceAccumulator {
+public:
+    // Накопитель текущего потока, общий для всех запросов в этом потоке
+    static RelevanceAccumulator& ForCurrentThread();
+
+    // Готовит накопитель к новому запросу по document_count порядковым номерам
+    void Reset(size_t document_count);
+
+    // Вклады в исключённый документ не учитываются
+    void Add(size_t ordinal, double relevance);
+    // Исключает документ из выдачи. Обычно вызывается до начисления вкладов: исключённые
+    // документы не попадают в число затронутых, и очищать их в Reset не нужно
+    void Exclude(size_t ordinal);
+
+    // Обходит набравшие релевантность и не исключённые документы: function(ordinal, relevance)
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    // Состояние документа - отметка в marks_: scored_mark_ или scored_mark_ + 1 (исключён)
+    // относятся к текущему запросу, остальные значения - к прошлым. Reset сдвигает отметки
+    // вместо очистки ячеек и обнуляет marks_ целиком, только когда они исчерпаны
+    static constexpr uint16_t MAX_SCORED_MARK = UINT16_MAX - 1;
+
+    std::vector<double> relevances_;
+    std::vector<uint16_t> marks_;
+    std::vector<size_t> touched_;
+    uint16_t scored_mark_ = 1;
+};
+
+inline void RelevanceAccumulator::Add(size_t ordinal, double relevance) {
+    uint16_t& mark = marks_[ordinal];
+    if (mark != scored_mark_) {
+        if (mark == scored_mark_ + 1) {
+            return;
+        }
+        mark = scored_mark_;
+        touched_.push_back(ordinal);
+    }
+    relevances_[ordinal] += relevance;
+}
+
+inline void RelevanceAccumulator::Exclude(size_t ordinal) {
+    marks_[ordinal] = scored_mark_ + 1;
+}
+
+template <typename Function>
+void RelevanceAccumulator::ForEach(Function function) const {
+    for (const size_t ordinal : touched_) {
+        if (marks_[ordinal] == scored_mark_) {
+            function(ordinal, relevances_[ordinal]);
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#include "remove_duplicates.h"
+
+#include <functional>
+#include <iostream>
+
+#include "hash_mix.h"
+
+using namespace std;
+
+namespace {
+bool HaveSameWords(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    const auto lhs_term_ids = lhs.GetTermIds();
+    const auto rhs_term_ids = rhs.GetTermIds();
+    return equal(lhs_term_ids.begin(), lhs_term_ids.end(), rhs_term_ids.begin(), rhs_term_ids.end());
+}
+}
+
+bool operator==(DocumentFingerprint lhs, DocumentFingerprint rhs) {
+    return lhs.low == rhs.low && lhs.high == rhs.high;
+}
+
+bool operator<(DocumentFingerprint lhs, DocumentFingerprint rhs) {
+    return pair{lhs.low, lhs.high} < pair{rhs.low, rhs.high};
+}
+
+DocumentFingerprint ComputeDocumentFingerprint(const WordFrequencies& word_freqs) {
+    // Сумма и xor хешей слов не зависят от порядка; число слов отличает наборы разного размера
+    DocumentFingerprint fingerprint{word_freqs.size(), 0};
+    for (const auto& [word, _] : word_freqs) {
+        const uint64_t word_hash = hash<string_view>{}(word);
+        fingerprint.low += MixHash(word_hash);
+        fingerprint.high ^= MixHash(word_hash ^ 0x5851F42D4C957F2D);
+    }
+    return fingerprint;
+}
+
+vector<int> VerifyFingerprintCollisions(const SearchServer& search_server,
+                                        const vector<pair<DocumentFingerprint, int>>& fingerprints) {
+    vector<int> duplicate_ids;
+    // Документы с разными наборами слов и одним отпечатком: каждый новый набор - свой образец
+    vector<int> originals;
+    for (size_t first = 0; first < fingerprints.size();) {
+        size_t last = first + 1;
+        while (last < fingerprints.size() && fingerprints[last].first == fingerprints[first].first) {
+            ++last;
+        }
+        originals.assign(1, fingerprints[first].second);
+        for (size_t i = first + 1; i < last; ++i) {
+            const int document_id = fingerprints[i].second;
+            const WordFrequencies word_freqs = search_server.GetWordFrequencies(document_id);
+            const bool is_duplicate = any_of(originals.begin(), originals.end(), [&](int original_id) {
+                return HaveSameWords(search_server.GetWordFrequencies(original_id), word_freqs);
+            });
+            if (is_duplicate) {
+                duplicate_ids.push_back(document_id);
+            } else {
+                originals.push_back(document_id);
+            }
+        }
+        first = last;
+    }
+    sort(duplicate_ids.begin(), duplicate_ids.end());
+    return duplicate_ids;
+}
+
+void PrintAndRemoveDuplicates(SearchServer& search_server, const vector<int>& duplicate_ids) {
+    for (const int document_id : duplicate_ids) {
+        cout << "Found duplicate document id "s << document_id << endl;
+    }
+    search_server.RemoveDocuments(duplicate_ids);
+}
+
+vector<int> FindDuplicates(const SearchServer& search_server) {
+    return FindDuplicates(execution::seq, search_server);
+}
+
+void RemoveDuplicates(SearchServer& search_server) {
+    RemoveDuplicates(execution::seq, search_server);
+}
+
+void RemoveNearDuplicates(SearchServer& search_server) {
+    vector<int> duplicate_ids;
+    for (const int document_id : search_server) {
+        const auto near_duplicates = search_server.FindNearDuplicates(document_id);
+        // Документ с меньшим id, который сам остаётся, уже просмотрен: он не в duplicate_ids
+        const bool has_original = any_of(near_duplicates.begin(), near_duplicates.end(), [&](int near_duplicate_id) {
+            return near_duplicate_id < document_id
+                && !binary_search(duplicate_ids.begin(), duplicate_ids.end(), near_duplicate_id);
+        });
+        if (has_original) {
+            duplicate_ids.push_back(document_id);
+        }
+    }
+    PrintAndRemoveDuplicates(search_server, duplicate_ids);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "search_server.h"
+
+// 128-битный отпечаток набора слов документа. Не зависит от порядка слов и их частот:
+// у документов с одинаковым набором слов отпечатки равны, у разных почти всегда различаются
+struct DocumentFingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+};
+
+bool operator==(DocumentFingerprint lhs, DocumentFingerprint rhs);
+bool operator<(DocumentFingerprint lhs, DocumentFingerprint rhs);
+
+DocumentFingerprint ComputeDocumentFingerprint(const WordFrequencies& word_freqs);
+
+// id дубликатов по возрастанию: документов, набор слов которых совпадает с документом с меньшим id.
+// Отпечатки считаются параллельно при policy = par; наборы слов сравниваются только
+// у документов с одинаковыми отпечатками
+template <typename ExecutionPolicy>
+std::vector<int> FindDuplicates(const ExecutionPolicy& policy, const SearchServer& search_server);
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+
+// Удаляет дубликаты одним пакетом и печатает их id
+template <typename ExecutionPolicy>
+void RemoveDuplicates(const ExecutionPolicy& policy, SearchServer& search_server);
+void RemoveDuplicates(SearchServer& search_server);
+
+// Удаляет документы, почти совпадающие с оставшимся документом с меньшим id, и печатает их id.
+// Требует включённого SearchServer::EnableNearDuplicateDetection
+void RemoveNearDuplicates(SearchServer& search_server);
+
+// Документы с одинаковым отпечатком: пары (отпечаток, id), отсортированные по отпечатку и id
+std::vector<int> VerifyFingerprintCollisions(const SearchServer& search_server,
+                                             const std::vector<std::pair<DocumentFingerprint, int>>& fingerprints);
+void PrintAndRemoveDuplicates(SearchServer& search_server, const std::vector<int>& duplicate_ids);
+
+template <typename ExecutionPolicy>
+std::vector<int> FindDuplicates(const ExecutionPolicy& policy, const SearchServer& search_server) {
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<std::pair<DocumentFingerprint, int>> fingerprints(document_ids.size());
+    std::transform(policy, document_ids.begin(), document_ids.end(), fingerprints.begin(),
+                   [&search_server](int document_id) {
+                       return std::pair{ComputeDocumentFingerprint(search_server.GetWordFrequencies(document_id)), document_id};
+                   });
+    std::sort(policy, fingerprints.begin(), fingerprints.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+    });
+    return VerifyFingerprintCollisions(search_server, fingerprints);
+}
+
+template <typename ExecutionPolicy>
+void RemoveDuplicates(const ExecutionPolicy& policy, SearchServer& search_server) {
+    PrintAndRemoveDuplicates(search_server, FindDuplicates(policy, search_server));
+}
@@ -1,6 +1,19 @@
 #include "search_server.h"
 
-
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+// "SRCHSNAP" в little-endian: снимок с другим порядком байт не пройдёт проверку
+const uint64_t SNAPSHOT_MAGIC = 0x50414E5348435253;
+const uint32_t SNAPSHOT_VERSION = 5;
+
+struct SnapshotTermFreq {
+    int term_id;
+    double term_freq;
+};
+}
 
 SearchServer::SearchServer(const std::string& stop_words_text)
 : SearchServer(std::string_view(stop_words_text))
@@ -13,26 +26,137 @@ SearchServer::SearchServer(std::string_view stop_words_text)
 
 
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (document_ordinals_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id");
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, std::string(document)});
-    document_ids_.insert(document_id);
+    // Слова проверяем до изменения индекса, чтобы при ошибке документ не добавился частично
+    const auto words = SplitIntoWordsNoStop(document);
+
+    const int ordinal = AddDocumentOrdinal(document_id, status, ComputeAverageRating(ratings), document_texts_.Append(document));
+    UpdateLogDocumentCount();
+    ++version_;
 
-    const auto words = SplitIntoWordsNoStop(documents_.at(document_id).str_words);
     const double inv_word_count = 1.0 / words.size();
-    
+
+    std::vector<int> word_term_ids;
+    word_term_ids.reserve(words.size());
     for (const std::string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        id_word_to_document_freqs_[document_id][word]+= inv_word_count;
+        word_term_ids.push_back(GetOrAddTermId(word));
+    }
+    std::sort(word_term_ids.begin(), word_term_ids.end());
+    std::vector<std::pair<int, double>> term_freqs;
+    for (const int term_id : word_term_ids) {
+        if (term_freqs.empty() || term_freqs.back().first != term_id) {
+            term_freqs.emplace_back(term_id, 0.0);
+            UpdateTermStatistics(term_id, 1);
+        }
+        term_freqs.back().second += inv_word_count;
+    }
+    index_->AddDocument(ordinal, term_freqs);
+    forward_index_.AddDocument(ordinal, std::move(term_freqs));
+    if (near_duplicates_) {
+        near_duplicates_->AddDocument(document_id, GetWordFrequencies(document_id));
     }
 }
 
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(std::execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-    });
+void SearchServer::AddDocuments(const std::vector<RawDocument>& documents) {
+    AddDocuments(std::execution::seq, documents);
+}
+
+
+void SearchServer::ValidateNewDocumentIds(const std::vector<RawDocument>& documents) const {
+    std::set<int> batch_ids;
+    for (const RawDocument& document : documents) {
+        if ((document.id < 0) || (document_ordinals_.count(document.id) > 0) || !batch_ids.insert(document.id).second) {
+            throw std::invalid_argument("Invalid document_id");
+        }
+    }
+}
+
+
+SearchServer::PartialIndex SearchServer::BuildPartialIndex(const std::vector<RawDocument>& documents, size_t first, size_t last,
+                                                          int first_ordinal) const {
+    PartialIndex index;
+    try {
+        index.document_words.reserve(last - first);
+        for (size_t i = first; i < last; ++i) {
+            const auto words = SplitIntoWordsNoStop(documents[i].text);
+            const double inv_word_count = 1.0 / words.size();
+            std::map<std::string_view, double> word_freqs;
+            for (const std::string_view word : words) {
+                word_freqs[word] += inv_word_count;
+            }
+
+            auto& document_words = index.document_words.emplace_back();
+            document_words.reserve(word_freqs.size());
+            for (const auto [word, term_freq] : word_freqs) {
+                const auto [it, inserted] = index.word_ids.emplace(word, static_cast<int>(index.words.size()));
+                if (inserted) {
+                    index.words.push_back(word);
+                    index.postings.emplace_back();
+                }
+                index.postings[it->second].push_back({first_ordinal + static_cast<int>(i), term_freq});
+                document_words.emplace_back(it->second, term_freq);
+            }
+        }
+    } catch (...) {
+        index.error = std::current_exception();
+    }
+    return index;
+}
+
+
+void SearchServer::MergePartialIndexes(const std::vector<RawDocument>& documents, const std::vector<PartialIndex>& parts) {
+    for (const PartialIndex& part : parts) {
+        if (part.error) {
+            std::rethrow_exception(part.error);
+        }
+    }
+
+    // Пакет целиком становится отдельным запечатанным сегментом. Порядковые номера идут
+    // подряд, поэтому словопозиции частей уже упорядочены и дописываются в конец списков
+    std::vector<int> ordinals;
+    ordinals.reserve(documents.size());
+    std::unordered_map<int, std::vector<Posting>> segment_postings;
+    size_t document_index = 0;
+    for (const PartialIndex& part : parts) {
+        std::vector<int> term_ids(part.words.size());
+        for (size_t word_id = 0; word_id < part.words.size(); ++word_id) {
+            term_ids[word_id] = GetOrAddTermId(part.words[word_id]);
+        }
+
+        for (const auto& document_words : part.document_words) {
+            const RawDocument& document = documents[document_index++];
+            const int ordinal = AddDocumentOrdinal(document.id, document.status, ComputeAverageRating(document.ratings),
+                                                   document_texts_.Append(document.text));
+            ordinals.push_back(ordinal);
+
+            std::vector<std::pair<int, double>> term_freqs;
+            term_freqs.reserve(document_words.size());
+            for (const auto& [word_id, term_freq] : document_words) {
+                term_freqs.emplace_back(term_ids[word_id], term_freq);
+            }
+            forward_index_.AddDocument(ordinal, std::move(term_freqs));
+            if (near_duplicates_) {
+                near_duplicates_->AddDocument(document.id, GetWordFrequencies(document.id));
+            }
+        }
+
+        for (size_t word_id = 0; word_id < part.words.size(); ++word_id) {
+            auto& postings = segment_postings[term_ids[word_id]];
+            postings.insert(postings.end(), part.postings[word_id].begin(), part.postings[word_id].end());
+            UpdateTermStatistics(term_ids[word_id], static_cast<int>(part.postings[word_id].size()));
+        }
+    }
+    UpdateLogDocumentCount();
+    ++version_;
+    index_->AddSegment(IndexSegment(index_->GetFormat(), std::move(ordinals), std::move(segment_postings)));
+}
+
+
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status, int top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, top_count);
 }
 
 
@@ -49,7 +173,7 @@ SearchServer::const_iterator SearchServer::end() const {
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ids_.size();
 }
 
 SearchServer::MatchedDocument SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
@@ -58,54 +182,202 @@ SearchServer::MatchedDocument SearchServer::MatchDocument(std::string_view raw_q
 
 SearchServer::MatchedDocument SearchServer::MatchDocument(const std::execution::sequenced_policy&,
                                                                                  std::string_view raw_query, int document_id) const {
-    const auto query = ParseQuery(raw_query);
-    
-    std::vector<std::string_view> matched_words;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    Query query = ParseQuery(raw_query);
+    const int ordinal = GetDocumentOrdinal(document_id);
+    SortQueryByTermId(query);
+    return MatchDocumentOrdinal(query, ordinal);
+}
+
+// Вместо одного слияния каждое слово запроса ищется в словах документа двоичным поиском,
+// независимо от других слов: проверки минус-слов и отбор плюс-слов идут параллельно
+SearchServer::MatchedDocument SearchServer::MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const {
+    const Query query = ParseQuery(raw_query);
+    const int ordinal = GetDocumentOrdinal(document_id);
+    const DocumentStatus status = ordinal_to_status_[ordinal];
+    const ArrayView<int> document_terms = forward_index_.GetTermIds(ordinal);
+    const auto is_in_document = [&document_terms](const Query::Word& word) {
+        return word.term_id >= 0 && std::binary_search(document_terms.begin(), document_terms.end(), word.term_id);
+    };
+
+    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), is_in_document)) {
+        return {std::vector<std::string_view>(), status};
+    }
+    // Плюс-слова запроса уже упорядочены по строкам, copy_if сохраняет порядок
+    std::vector<Query::Word> matched(query.plus_words.size());
+    matched.erase(std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched.begin(), is_in_document),
+                  matched.end());
+    std::vector<std::string_view> matched_words(matched.size());
+    std::transform(matched.begin(), matched.end(), matched_words.begin(), [](const Query::Word& word) {
+        return word.data;
+    });
+    return {matched_words, status};
+}
+
+std::vector<SearchServer::MatchedDocument> SearchServer::MatchDocuments(std::string_view raw_query, ArrayView<int> document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+std::vector<SearchServer::MatchedDocument> SearchServer::MatchDocuments(const std::execution::sequenced_policy&, std::string_view raw_query,
+                                                                        ArrayView<int> document_ids) const {
+    Query query = ParseQuery(raw_query);
+    std::vector<int> ordinals(document_ids.size());
+    std::transform(document_ids.begin(), document_ids.end(), ordinals.begin(), [this](int document_id) {
+        return GetDocumentOrdinal(document_id);
+    });
+    SortQueryByTermId(query);
+
+    std::vector<MatchedDocument> matched_documents(ordinals.size());
+    std::transform(ordinals.begin(), ordinals.end(), matched_documents.begin(), [this, &query](int ordinal) {
+        return MatchDocumentOrdinal(query, ordinal);
+    });
+    return matched_documents;
+}
+
+std::vector<SearchServer::MatchedDocument> SearchServer::MatchDocuments(const std::execution::parallel_policy&, std::string_view raw_query,
+                                                                        ArrayView<int> document_ids) const {
+    Query query = ParseQuery(raw_query);
+    std::vector<int> ordinals(document_ids.size());
+    std::transform(document_ids.begin(), document_ids.end(), ordinals.begin(), [this](int document_id) {
+        return GetDocumentOrdinal(document_id);
+    });
+    SortQueryByTermId(query);
+
+    std::vector<MatchedDocument> matched_documents(ordinals.size());
+    std::transform(std::execution::par, ordinals.begin(), ordinals.end(), matched_documents.begin(), [this, &query](int ordinal) {
+        return MatchDocumentOrdinal(query, ordinal);
+    });
+    return matched_documents;
+}
+
+void SearchServer::SortQueryByTermId(Query& query) {
+    for (auto* words : {&query.plus_words, &query.minus_words}) {
+        words->erase(std::remove_if(words->begin(), words->end(), [](const Query::Word& word) {
+            return word.term_id < 0;
+        }), words->end());
+        std::sort(words->begin(), words->end(), [](const Query::Word& lhs, const Query::Word& rhs) {
+            return lhs.term_id < rhs.term_id;
+        });
+    }
+}
+
+SearchServer::MatchedDocument SearchServer::MatchDocumentOrdinal(const Query& query, int ordinal) const {
+    const DocumentStatus status = ordinal_to_status_[ordinal];
+    const ArrayView<int> document_terms = forward_index_.GetTermIds(ordinal);
+
+    // Обе последовательности упорядочены по term_id, поэтому общий указатель по словам
+    // документа только движется вперёд
+    const int* term = document_terms.begin();
+    for (const Query::Word& word : query.minus_words) {
+        while (term != document_terms.end() && *term < word.term_id) {
+            ++term;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+        if (term == document_terms.end()) {
+            break;
+        }
+        if (*term == word.term_id) {
+            return {std::vector<std::string_view>(), status};
         }
     }
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+
+    std::vector<std::string_view> matched_words;
+    term = document_terms.begin();
+    for (const Query::Word& word : query.plus_words) {
+        while (term != document_terms.end() && *term < word.term_id) {
+            ++term;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.clear();
+        if (term == document_terms.end()) {
             break;
         }
+        if (*term == word.term_id) {
+            matched_words.push_back(word.data);
+        }
     }
-    return {matched_words, documents_.at(document_id).status};
+    // Слова выдаются в порядке строк, как в запросе
+    std::sort(matched_words.begin(), matched_words.end());
+    return {matched_words, status};
 }
 
-SearchServer::MatchedDocument SearchServer::MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const {
-    const auto query = ParseQuery(raw_query);
-
-    std::vector<std::string_view> matched_words(query.plus_words.size());
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        return {};
+    }
+    const int ordinal = it->second;
+    return {terms_.data(), forward_index_.GetTermIds(ordinal), forward_index_.GetTermFreqs(ordinal)};
+}
 
-    auto check_word_in_document = [this, document_id](std::string_view word) {
-        return word_to_document_freqs_.at(word).count(document_id);
-    };
+std::map<std::string_view, double> SearchServer::GetWordFrequenciesMap(int document_id) const {
+    std::map<std::string_view, double> word_freqs;
+    for (const auto [word, term_freq] : GetWordFrequencies(document_id)) {
+        word_freqs.emplace(word, term_freq);
+    }
+    return word_freqs;
+}
 
+void SearchServer::EnableNearDuplicateDetection(double jaccard_threshold) {
+    auto near_duplicates = std::make_unique<NearDuplicateIndex>(jaccard_threshold);
+    for (const int document_id : document_ids_) {
+        near_duplicates->AddDocument(document_id, GetWordFrequencies(document_id));
+    }
+    near_duplicates_ = std::move(near_duplicates);
+}
 
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), check_word_in_document)) {
-        return {std::vector<std::string_view>(), documents_.at(document_id).status};
+std::vector<int> SearchServer::FindNearDuplicates(int document_id) const {
+    if (!near_duplicates_) {
+        throw std::logic_error("Near-duplicate detection is not enabled");
     }
+    // Для неизвестного документа - out_of_range
+    GetDocumentOrdinal(document_id);
+    const WordFrequencies word_freqs = GetWordFrequencies(document_id);
+    std::vector<int> near_duplicates;
+    for (const int candidate_id : near_duplicates_->FindCandidates(document_id)) {
+        if (ComputeJaccardSimilarity(word_freqs, GetWordFrequencies(candidate_id)) >= near_duplicates_->GetJaccardThreshold()) {
+            near_duplicates.push_back(candidate_id);
+        }
+    }
+    return near_duplicates;
+}
 
-    std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), check_word_in_document);
+void SearchServer::SetPostingFormat(PostingFormat format) {
+    index_->SetFormat(format);
+}
 
-    return {matched_words, documents_.at(document_id).status};
+PostingFormat SearchServer::GetPostingFormat() const {
+    return index_->GetFormat();
 }
 
-const std::map<std::string_view , double>& SearchServer::GetWordFrequencies(int document_id) const {
-    if (id_word_to_document_freqs_.count(document_id)){
-        return id_word_to_document_freqs_.at(document_id);
-    }
-    static const std::map<std::string_view , double> empty_doc;
-    return empty_doc;
+size_t SearchServer::GetPostingMemoryUsage() const {
+    return index_->GetMemoryUsage();
+}
+
+void SearchServer::SetQueryEngine(QueryEngine engine) {
+    query_engine_ = engine;
+}
+
+QueryEngine SearchServer::GetQueryEngine() const {
+    return query_engine_;
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+    query_cache_capacity_ = capacity;
+    query_plan_cache_->SetCapacity(capacity);
+}
+
+CacheStatistics SearchServer::GetQueryCacheStatistics() const {
+    return query_plan_cache_->GetStatistics();
+}
+
+void SearchServer::SetResultCacheOptions(ResultCacheOptions options) {
+    result_cache_options_ = options;
+    result_cache_->SetCapacity(options.capacity);
+}
+
+CacheStatistics SearchServer::GetResultCacheStatistics() const {
+    return result_cache_->GetStatistics();
+}
+
+void SearchServer::SetWriteSegmentSize(size_t document_count) {
+    index_->SetWriteSegmentSize(document_count);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
@@ -114,31 +386,93 @@ void SearchServer::RemoveDocument(int document_id) {
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id){
     if (document_ids_.count(document_id)){
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
-        for (auto [word, _] : id_word_to_document_freqs_.at(document_id)){
-            word_to_document_freqs_.at(word).erase(document_id);
-            }
-        id_word_to_document_freqs_.erase(document_id);
+        for (const int term_id : forward_index_.GetTermIds(GetDocumentOrdinal(document_id))) {
+            UpdateTermStatistics(term_id, -1);
+        }
+        MarkDocumentRemoved(document_id);
     }
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
     if (document_ids_.count(document_id)){
-        documents_.erase(document_id);
-        document_ids_.erase(document_id);
-        const auto &words_to_freqs = id_word_to_document_freqs_.at(document_id);
+        const auto term_ids = forward_index_.GetTermIds(GetDocumentOrdinal(document_id));
 
-        for_each(std::execution::par, words_to_freqs.begin(), words_to_freqs.end(),
-                 [this, &document_id](const auto& word_freq) {
-                    word_to_document_freqs_.at(word_freq.first).erase(document_id);
+        // У каждого слова документа своя запись статистики, поэтому обновления не пересекаются
+        std::for_each(std::execution::par, term_ids.begin(), term_ids.end(),
+                 [this](int term_id) {
+                    UpdateTermStatistics(term_id, -1);
                 });
-        id_word_to_document_freqs_.erase(document_id);
+        MarkDocumentRemoved(document_id);
+    }
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    for (const int document_id : document_ids) {
+        RemoveDocument(document_id);
+    }
+    if (!removed_ordinals_.empty()) {
+        ReleaseRemovedDocuments();
+    }
+}
+
+void SearchServer::CleanupRemovedDocuments() {
+    ReleaseRemovedDocuments();
+    index_->PurgeDeleted();
+}
+
+void SearchServer::MarkDocumentRemoved(int document_id) {
+    const int ordinal = GetDocumentOrdinal(document_id);
+    ReleaseText(document_texts_, ordinal_to_text_[ordinal]);
+    ordinal_to_text_[ordinal] = {};
+    document_ordinals_.erase(document_id);
+    document_ids_.erase(document_id);
+    if (static_cast<size_t>(ordinal_to_status_[ordinal]) < DOCUMENT_STATUS_COUNT) {
+        status_documents_[static_cast<size_t>(ordinal_to_status_[ordinal])].Erase(ordinal);
+    }
+    UpdateLogDocumentCount();
+    ++version_;
+    index_->RemoveDocument(ordinal);
+    if (near_duplicates_) {
+        near_duplicates_->RemoveDocument(document_id);
+    }
+    // Слова документа разбираются позже, пакетом
+    forward_index_.RemoveDocument(ordinal);
+    removed_ordinals_.push_back(ordinal);
+    ReleaseRemovedDocumentsIfNeeded();
+}
+
+void SearchServer::ReleaseRemovedDocuments() {
+    // Словопозиции со свободным term_id остались только у удалённых документов и при поиске
+    // отбрасываются, поэтому term_id можно сразу отдать новому слову
+    for (const int ordinal : removed_ordinals_) {
+        for (const int term_id : forward_index_.GetTermIds(ordinal)) {
+            if (term_statistics_[term_id].document_count != 0) {
+                continue;
+            }
+            // Слово могло освободиться раньше, при разборе другого удалённого документа
+            const auto it = term_ids_.find(terms_[term_id]);
+            if (it != term_ids_.end() && it->second == term_id) {
+                ReleaseText(term_texts_, terms_[term_id]);
+                terms_[term_id] = {};
+                free_term_ids_.push_back(term_id);
+                term_ids_.erase(it);
+            }
+        }
+    }
+    removed_ordinals_.clear();
+    removed_ordinals_.shrink_to_fit();
+    forward_index_.CompactIfNeeded();
+    CompactDocumentTextsIfNeeded();
+}
+
+void SearchServer::ReleaseRemovedDocumentsIfNeeded() {
+    if (removed_ordinals_.size() >= std::max(MIN_REMOVED_DOCUMENTS_PER_CLEANUP, document_ids_.size() / 4)) {
+        ReleaseRemovedDocuments();
     }
 }
 
 bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_word_filter_.Contains(word);
 }
 
 
@@ -152,18 +486,83 @@ bool SearchServer::IsValidWord(std::string_view word) {
 
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
     std::vector<std::string_view> words;
-    for (const std::string_view word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
+    ForEachWord(text, [this, &words](std::string_view word, bool is_valid) {
+        if (!is_valid) {
             throw std::invalid_argument("Word " + static_cast<std::string>(word) + " is invalid");
         }
         if (!IsStopWord(word)) {
             words.push_back(word);
         }
-    }
+    });
     return words;
 }
 
 
+int SearchServer::GetDocumentOrdinal(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        throw std::out_of_range("Unknown document_id " + std::to_string(document_id));
+    }
+    return it->second;
+}
+
+
+int SearchServer::AddDocumentOrdinal(int document_id, DocumentStatus status, int rating, std::string_view text) {
+    const int ordinal = static_cast<int>(ordinal_to_document_id_.size());
+    document_ordinals_.emplace(document_id, ordinal);
+    ordinal_to_document_id_.push_back(document_id);
+    ordinal_to_rating_.push_back(rating);
+    ordinal_to_status_.push_back(status);
+    ordinal_to_text_.push_back(text);
+    document_ids_.insert(document_id);
+    if (static_cast<size_t>(status) < DOCUMENT_STATUS_COUNT) {
+        status_documents_[static_cast<size_t>(status)].Insert(ordinal);
+    }
+    return ordinal;
+}
+
+
+const DocumentBitmap& SearchServer::GetStatusDocuments(DocumentStatus status) const {
+    static const DocumentBitmap empty_documents;
+    return static_cast<size_t>(status) < DOCUMENT_STATUS_COUNT ? status_documents_[static_cast<size_t>(status)] : empty_documents;
+}
+
+
+int SearchServer::GetOrAddTermId(std::string_view word) {
+    if (const auto it = term_ids_.find(word); it != term_ids_.end()) {
+        return it->second;
+    }
+    int term_id;
+    if (!free_term_ids_.empty()) {
+        term_id = free_term_ids_.back();
+        free_term_ids_.pop_back();
+        terms_[term_id] = term_texts_.Append(word);
+    } else {
+        term_id = static_cast<int>(terms_.size());
+        terms_.push_back(term_texts_.Append(word));
+        term_statistics_.emplace_back();
+    }
+    term_ids_.emplace(terms_[term_id], term_id);
+    return term_id;
+}
+
+
+int SearchServer::FindTermId(std::string_view word) const {
+    const auto it = term_ids_.find(word);
+    if (it != term_ids_.end() && term_statistics_[it->second].document_count > 0) {
+        return it->second;
+    }
+    return -1;
+}
+
+
+void SearchServer::UpdateTermStatistics(int term_id, int document_count_delta) {
+    TermStatistics& statistics = term_statistics_[term_id];
+    statistics.document_count += document_count_delta;
+    statistics.log_document_count = std::log(static_cast<double>(statistics.document_count));
+}
+
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
@@ -194,22 +593,271 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
 
 SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
     Query result;
-    for (std::string_view word : SplitIntoWords(text)) {
+    ForEachWord(text, [this, &result](std::string_view word, bool) {
         const auto query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.insert(query_word.data);
-            } else {
-                result.plus_words.insert(query_word.data);
-            }
+            (query_word.is_minus ? result.minus_words : result.plus_words).push_back({query_word.data, -1});
+        }
+    });
+    for (auto* words : {&result.plus_words, &result.minus_words}) {
+        std::sort(words->begin(), words->end(), [](const Query::Word& lhs, const Query::Word& rhs) {
+            return lhs.data < rhs.data;
+        });
+        words->erase(std::unique(words->begin(), words->end(), [](const Query::Word& lhs, const Query::Word& rhs) {
+            return lhs.data == rhs.data;
+        }), words->end());
+        for (Query::Word& word : *words) {
+            word.term_id = FindTermId(word.data);
         }
     }
     return result;
 }
 
 
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+std::shared_ptr<const SearchServer::QueryPlan> SearchServer::GetQueryPlan(std::string_view raw_query) const {
+    const uint64_t version = version_;
+    if (query_cache_capacity_ > 0) {
+        auto cached_query = query_plan_cache_->Find(raw_query, [version](const QueryPlan& query) {
+            return query.version == version;
+        });
+        if (cached_query) {
+            return cached_query;
+        }
+    }
+
+    const auto parsed_query = ParseQuery(raw_query);
+    auto query = std::make_shared<QueryPlan>();
+    query->version = version;
+    for (const auto [word, term_id] : parsed_query.plus_words) {
+        if (term_id >= 0) {
+            query->plus_terms.push_back({term_id, ComputeWordInverseDocumentFreq(term_id)});
+        }
+    }
+    for (const auto [word, term_id] : parsed_query.minus_words) {
+        if (term_id >= 0) {
+            query->minus_terms.push_back(term_id);
+        }
+    }
+    if (query_cache_capacity_ > 0) {
+        query_plan_cache_->Insert(raw_query, query);
+    }
+    return query;
+}
+
+
+std::string SearchServer::MakeResultCacheKey(const QueryPlan& query, DocumentStatus status, int top_count, bool is_max_score) {
+    // Слова в плане упорядочены и не повторяются, поэтому запросы с одинаковым набором слов дают одинаковый ключ
+    std::string key;
+    auto append = [&key](auto value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    append(static_cast<int>(status));
+    append(top_count);
+    append(is_max_score);
+    append(query.plus_terms.size());
+    for (const auto [term_id, _] : query.plus_terms) {
+        append(term_id);
+    }
+    for (const int term_id : query.minus_terms) {
+        append(term_id);
+    }
+    return key;
+}
+
+
+double SearchServer::ComputeWordInverseDocumentFreq(int term_id) const {
+    // log(N / df) из двух заранее посчитанных логарифмов
+    return log_document_count_ - term_statistics_[term_id].log_document_count;
+}
+
+
+void SearchServer::CompactDocumentTextsIfNeeded() {
+    if (document_texts_.GetReleasedBytes() < TextArena::CHUNK_SIZE
+        || document_texts_.GetReleasedBytes() * 2 < document_texts_.GetUsedBytes()) {
+        return;
+    }
+    TextArena document_texts;
+    // У удалённых документов текст уже пустой
+    for (std::string_view& text : ordinal_to_text_) {
+        text = document_texts.Append(text);
+    }
+    document_texts_ = std::move(document_texts);
+}
+
+
+void SearchServer::CompactTermTexts() {
+    if (term_texts_.GetReleasedBytes() == 0) {
+        return;
+    }
+    TextArena term_texts;
+    // У свободных term_id слово уже пустое
+    for (std::string_view& term : terms_) {
+        term = term_texts.Append(term);
+    }
+    std::unordered_map<std::string_view, int> term_ids;
+    term_ids.reserve(term_ids_.size());
+    for (const auto& [term, term_id] : term_ids_) {
+        term_ids.emplace(terms_[term_id], term_id);
+    }
+    term_ids_ = std::move(term_ids);
+    term_texts_ = std::move(term_texts);
+}
+
+
+void SearchServer::UpdateLogDocumentCount() {
+    log_document_count_ = std::log(static_cast<double>(document_ids_.size()));
+}
+
+
+void SearchServer::ReleaseText(TextArena& texts, std::string_view text) {
+    if (!snapshot_ || !snapshot_->Contains(text.data())) {
+        texts.Release(text);
+    }
+}
+
+
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    // Снимок пишется во временный файл рядом и подменяет path переименованием. Так можно
+    // сохраниться поверх снимка, из которого сервер загружен: его отображение в память
+    // продолжает указывать на прежний файл, а не на обрезанный
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+        if (!output) {
+            throw std::runtime_error("Cannot create snapshot " + temp_path);
+        }
+        WriteSnapshot(output);
+        output.close();
+        if (!output) {
+            std::remove(temp_path.c_str());
+            throw std::runtime_error("Cannot write snapshot " + temp_path);
+        }
+    }
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("Cannot replace snapshot " + path);
+    }
+}
+
+void SearchServer::WriteSnapshot(std::ostream& output) const {
+    SnapshotWriter writer(output);
+    writer.WriteValue(SNAPSHOT_MAGIC);
+    writer.WriteValue(SNAPSHOT_VERSION);
+    writer.WriteValue<uint32_t>(sizeof(Posting));
+    writer.WriteValue(static_cast<uint32_t>(index_->GetFormat()));
+
+    writer.WriteValue<uint64_t>(stop_words_.size());
+    for (const std::string& stop_word : stop_words_) {
+        writer.WriteString(stop_word);
+    }
+
+    writer.WriteValue<uint64_t>(terms_.size());
+    for (const std::string_view term : terms_) {
+        writer.WriteString(term);
+    }
+    writer.WriteValue<uint64_t>(free_term_ids_.size());
+    writer.WriteArray(free_term_ids_.data(), free_term_ids_.size());
+    index_->Save(writer);
+
+    // Сегменты ссылаются на порядковые номера, поэтому они сохраняются как есть, вместе с пропусками
+    writer.WriteValue<uint64_t>(ordinal_to_document_id_.size());
+    writer.WriteValue<uint64_t>(document_ids_.size());
+    std::vector<SnapshotTermFreq> term_freqs;
+    for (const int document_id : document_ids_) {
+        const int ordinal = document_ordinals_.at(document_id);
+        writer.WriteValue(document_id);
+        writer.WriteValue(ordinal);
+        writer.WriteValue(ordinal_to_rating_[ordinal]);
+        writer.WriteValue(static_cast<int>(ordinal_to_status_[ordinal]));
+        writer.WriteString(ordinal_to_text_[ordinal]);
+        term_freqs.clear();
+        const auto term_ids = forward_index_.GetTermIds(ordinal);
+        const auto document_term_freqs = forward_index_.GetTermFreqs(ordinal);
+        for (size_t i = 0; i < term_ids.size(); ++i) {
+            term_freqs.push_back({term_ids[i], document_term_freqs[i]});
+        }
+        writer.WriteValue<uint64_t>(term_freqs.size());
+        writer.WriteArray(term_freqs.data(), term_freqs.size());
+    }
+}
+
+
+SearchServer SearchServer::LoadSnapshot(const std::string& path) {
+    auto snapshot = std::make_unique<MappedFile>(path);
+    SnapshotReader reader(snapshot->data(), snapshot->size());
+    if (reader.ReadValue<uint64_t>() != SNAPSHOT_MAGIC
+        || reader.ReadValue<uint32_t>() != SNAPSHOT_VERSION
+        || reader.ReadValue<uint32_t>() != sizeof(Posting)) {
+        throw std::runtime_error("Unsupported snapshot format " + path);
+    }
+    const auto posting_format = static_cast<PostingFormat>(reader.ReadValue<uint32_t>());
+
+    std::vector<std::string_view> stop_words(reader.ReadValue<uint64_t>());
+    for (std::string_view& stop_word : stop_words) {
+        stop_word = reader.ReadString();
+    }
+    SearchServer server(stop_words);
+    server.index_ = std::make_unique<SegmentedIndex>(posting_format);
+
+    const auto term_count = reader.ReadValue<uint64_t>();
+    server.terms_.reserve(term_count);
+    server.term_ids_.reserve(term_count);
+    server.term_statistics_.resize(term_count);
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        server.terms_.push_back(reader.ReadString());
+    }
+    // Пустое слово тоже бывает настоящим, поэтому свободные term_id записаны отдельно
+    const auto free_term_ids = reader.ReadArray<int>(reader.ReadValue<uint64_t>());
+    server.free_term_ids_.assign(free_term_ids.begin(), free_term_ids.end());
+    std::vector<bool> is_free(term_count);
+    for (const int term_id : server.free_term_ids_) {
+        is_free.at(term_id) = true;
+    }
+    for (size_t term_id = 0; term_id < term_count; ++term_id) {
+        if (!is_free[term_id]) {
+            server.term_ids_.emplace(server.terms_[term_id], static_cast<int>(term_id));
+        }
+    }
+    server.index_->Load(reader);
+
+    const auto ordinal_count = reader.ReadValue<uint64_t>();
+    server.ordinal_to_document_id_.assign(ordinal_count, -1);
+    server.ordinal_to_rating_.assign(ordinal_count, 0);
+    server.ordinal_to_status_.assign(ordinal_count, DocumentStatus::REMOVED);
+    server.ordinal_to_text_.assign(ordinal_count, {});
+    const auto document_count = reader.ReadValue<uint64_t>();
+    server.document_ordinals_.reserve(document_count);
+    for (size_t i = 0; i < document_count; ++i) {
+        const auto document_id = reader.ReadValue<int>();
+        const auto ordinal = reader.ReadValue<int>();
+        if (ordinal < 0 || static_cast<size_t>(ordinal) >= ordinal_count || !server.document_ordinals_.emplace(document_id, ordinal).second) {
+            throw std::runtime_error("Invalid document ordinal in snapshot " + path);
+        }
+        server.ordinal_to_document_id_[ordinal] = document_id;
+        server.ordinal_to_rating_[ordinal] = reader.ReadValue<int>();
+        const auto status = static_cast<DocumentStatus>(reader.ReadValue<int>());
+        server.ordinal_to_status_[ordinal] = status;
+        if (static_cast<size_t>(status) < DOCUMENT_STATUS_COUNT) {
+            server.status_documents_[static_cast<size_t>(status)].Insert(ordinal);
+        }
+        server.ordinal_to_text_[ordinal] = reader.ReadString();
+        server.document_ids_.insert(server.document_ids_.end(), document_id);
+
+        const auto snapshot_term_freqs = reader.ReadArray<SnapshotTermFreq>(reader.ReadValue<uint64_t>());
+        std::vector<std::pair<int, double>> term_freqs;
+        term_freqs.reserve(snapshot_term_freqs.size());
+        for (const SnapshotTermFreq& term_freq : snapshot_term_freqs) {
+            ++server.term_statistics_.at(term_freq.term_id).document_count;
+            term_freqs.emplace_back(term_freq.term_id, term_freq.term_freq);
+        }
+        server.forward_index_.AddDocument(ordinal, std::move(term_freqs));
+    }
+    for (TermStatistics& statistics : server.term_statistics_) {
+        statistics.log_document_count = std::log(static_cast<double>(statistics.document_count));
+    }
+    server.UpdateLogDocumentCount();
+    server.snapshot_ = std::move(snapshot);
+    return server;
 }
 
 
@@ -258,9 +906,11 @@ void FindTopDocuments(const SearchServer& search_server, const std::string& raw_
 void MatchDocuments(const SearchServer& search_server, const std::string& query) {
     try {
         std::cout << "Матчинг документов по запросу: " << query << std::endl;
-        for (const int document_id : search_server) {
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const std::vector<int> document_ids(search_server.begin(), search_server.end());
+        const auto matched_documents = search_server.MatchDocuments(query, document_ids);
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            const auto& [words, status] = matched_documents[i];
+            PrintMatchDocumentResult(document_ids[i], words, status);
         }
     } catch (const std::invalid_argument& e) {
         std::cout << "Ошибка матчинга документов на запрос " << query << ": " << e.what() << std::endl;
@@ -1,20 +1,71 @@
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <cmath>
 #include <iostream>
+#include <exception>
 #include <map>
+#include <numeric>
 #include <set>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <algorithm>
 #include <string_view>
 #include <execution>
+#include <limits>
+#include <memory>
+#include <type_traits>
 #include "string_processing.h"
 #include "document.h"
+#include "document_bitmap.h"
+#include "forward_index.h"
+#include "lru_cache.h"
+#include "mapped_file.h"
+#include "near_duplicate_index.h"
 #include "paginator.h"
-#include "concurrent_map.h"
+#include "posting_list.h"
+#include "relevance_accumulator.h"
+#include "segmented_index.h"
+#include "small_vector.h"
+#include "stop_word_filter.h"
+#include "text_arena.h"
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
+// Минимальный объём работы (число словопозиций) на одну часть параллельного подсчёта
+const size_t MIN_POSTINGS_PER_PART = 4096;
+// Во сколько раз список минус-слова должен быть длиннее списков плюс-слов сегмента, чтобы его
+// выгоднее было вычитать скачками курсора, чем целиком отмечать исключённые документы
+const size_t MIN_MINUS_POSTINGS_RATIO_FOR_SKIPS = 256;
+// Минимальное число документов на одну часть пакетного добавления
+const size_t MIN_DOCUMENTS_PER_PART = 256;
+// Число частей кеша планов запросов
+const size_t QUERY_CACHE_SHARD_COUNT = 16;
+// Число частей кеша результатов FindTopDocuments
+const size_t RESULT_CACHE_SHARD_COUNT = 16;
+// Столько плюс- и минус-слов запроса хранится без выделения памяти
+const size_t QUERY_INLINE_WORD_COUNT = 16;
+
+// Кеш готовых результатов FindTopDocuments с фильтром по статусу. Результат живёт не дольше ttl
+// и устаревает при любом добавлении или удалении документа. capacity = 0 выключает кеш
+struct ResultCacheOptions {
+    size_t capacity = 0;
+    std::chrono::steady_clock::duration ttl = std::chrono::seconds(60);
+};
+// Минимальное число удалённых документов, прямой индекс которых освобождается одним пакетом
+const size_t MIN_REMOVED_DOCUMENTS_PER_CLEANUP = 256;
+// Число значений DocumentStatus
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+// Алгоритм ранжирования для последовательной версии FindTopDocuments.
+// MAX_SCORE не досчитывает документы, которые по верхним оценкам вкладов слов
+// уже не могут попасть в top_count лучших
+enum class QueryEngine {
+    EXHAUSTIVE,
+    MAX_SCORE,
+};
 
 class SearchServer {
 public:
@@ -24,17 +75,29 @@ public:
     explicit SearchServer(std::string_view stop_words_text);
     
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Пакетное добавление: документы разбиваются на слова по частям (параллельно при policy = par),
+    // затем частичные индексы сливаются в основной за один проход.
+    // Правила проверки те же, что у AddDocument; при ошибке не добавляется ни один документ
+    template <typename ExecutionPolicy>
+    void AddDocuments(const ExecutionPolicy& policy, const std::vector<RawDocument>& documents);
+    void AddDocuments(const std::vector<RawDocument>& documents);
     
+    // top_count - сколько лучших документов вернуть, по умолчанию MAX_RESULT_DOCUMENT_COUNT
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+                                           int top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const;
@@ -46,33 +109,182 @@ public:
     
     int GetDocumentCount() const;
 
+    // Слова в результатах MatchDocument указывают в raw_query
     using MatchedDocument = std::tuple<std::vector<std::string_view>, DocumentStatus>;
     MatchedDocument MatchDocument(const std::string_view raw_query, int document_id) const;
     MatchedDocument MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
     MatchedDocument MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
+    // MatchDocument для нескольких документов с одним разбором запроса, результаты в порядке document_ids.
+    // Если какого-то документа нет, выбрасывает out_of_range до сопоставления
+    std::vector<MatchedDocument> MatchDocuments(std::string_view raw_query, ArrayView<int> document_ids) const;
+    std::vector<MatchedDocument> MatchDocuments(const std::execution::sequenced_policy&, std::string_view raw_query,
+                                                ArrayView<int> document_ids) const;
+    std::vector<MatchedDocument> MatchDocuments(const std::execution::parallel_policy&, std::string_view raw_query,
+                                                ArrayView<int> document_ids) const;
+
+    // Слова документа с TF в порядке term_id; пусто, если документа нет.
+    // Слова указывают в словарь сервера и действительны, пока жив сервер и не вызван CompactTermTexts
+    WordFrequencies GetWordFrequencies(int document_id) const;
+    // То же в виде словаря, упорядоченного по словам
+    std::map<std::string_view, double> GetWordFrequenciesMap(int document_id) const;
+
+    // Формат хранения списков словопозиций; при смене существующие списки перекодируются
+    void SetPostingFormat(PostingFormat format);
+    PostingFormat GetPostingFormat() const;
+    size_t GetPostingMemoryUsage() const;
+
+    void SetQueryEngine(QueryEngine engine);
+    QueryEngine GetQueryEngine() const;
 
-    const std::map<std::string_view , double>& GetWordFrequencies(int document_id) const;
+    // FindTopDocuments кеширует план запроса: слова запроса уже разобраны, сопоставлены с term_id
+    // и снабжены IDF. Ключ - текст запроса; план устаревает при любом добавлении или удалении
+    // документа. По умолчанию кеш выключен (capacity = 0): даже попадание в кеш берёт мьютекс
+    // его части, и параллельные читатели одного запроса ждут друг друга
+    void SetQueryCacheCapacity(size_t capacity);
+    CacheStatistics GetQueryCacheStatistics() const;
 
+    // Запросы с тем же набором слов (порядок и повторы не важны), статусом и top_count
+    // берут результат из кеша. Запросы с произвольным предикатом не кешируются
+    void SetResultCacheOptions(ResultCacheOptions options);
+    CacheStatistics GetResultCacheStatistics() const;
+
+    // Сколько документов копится в изменяемом сегменте индекса, прежде чем он запечатывается
+    // и уходит на фоновое слияние (по умолчанию SegmentedIndex::DEFAULT_WRITE_SEGMENT_SIZE)
+    void SetWriteSegmentSize(size_t document_count);
+
+    // Удаление только помечает документ: в индексе он остаётся до фонового слияния сегментов
+    // и отбрасывается при поиске, а его прямой индекс освобождается пакетом вместе с другими
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
+    // Удаляет пакет документов; их прямой индекс освобождается одним проходом в конце
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    // Освобождает всё, что осталось от удалённых документов: прямой индекс, слова, которых
+    // больше нет ни в одном документе, и словопозиции в индексе (переписываются в фоне)
+    void CleanupRemovedDocuments();
+    // Переносит словарь в новое хранилище и возвращает память слов, которых больше нет
+    // ни в одном документе. Слова, полученные раньше из GetWordFrequencies, после вызова недействительны
+    void CompactTermTexts();
+
+    // Включает поиск почти одинаковых документов: строит MinHash-подписи для всех документов
+    // и дальше поддерживает их при добавлении и удалении. Порог - коэффициент Жаккара наборов слов.
+    // В снимок подписи не попадают
+    void EnableNearDuplicateDetection(double jaccard_threshold);
+    // Документы, наборы слов которых похожи на document_id не меньше чем на порог, по возрастанию id
+    std::vector<int> FindNearDuplicates(int document_id) const;
+
+    // Двоичный снимок индекса. При загрузке файл отображается в память: списки словопозиций,
+    // слова и тексты документов читаются прямо из него и копируются только при изменении.
+    // Прямой индекс по документам пересобирается при загрузке.
+    // SaveSnapshot заменяет path целиком, в том числе снимок, из которого загружен сервер
+    void SaveSnapshot(const std::string& path) const;
+    static SearchServer LoadSnapshot(const std::string& path);
 
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::string str_words;
-    };
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view , std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view , double>> id_word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
+    const StopWordFilter stop_word_filter_;
+    // Словарь интернированных слов: term_id -> слово, сами строки лежат в term_texts_
+    TextArena term_texts_;
+    std::vector<std::string_view> terms_;
+    std::unordered_map<std::string_view, int> term_ids_;
+    // term_id слов, убранных из словаря; в terms_ на их месте пустые строки, а сами строки
+    // учтены в term_texts_ как удалённые.
+    // Пустое слово в тексте возможно, поэтому по terms_ свободный term_id не распознать
+    std::vector<int> free_term_ids_;
+    // Число живых документов со словом и его логарифм, по term_id. Словопозиции разнесены
+    // по сегментам и могут относиться к удалённым документам, поэтому df считается здесь
+    struct TermStatistics {
+        int document_count = 0;
+        double log_document_count = -std::numeric_limits<double>::infinity();
+    };
+    std::vector<TermStatistics> term_statistics_;
+    QueryEngine query_engine_ = QueryEngine::MAX_SCORE;
+    // Растёт при каждом изменении набора документов: от него зависят IDF в планах запросов
+    uint64_t version_ = 0;
+    // log(N) для IDF
+    double log_document_count_ = -std::numeric_limits<double>::infinity();
+    // Прямой индекс по порядковым номерам документов
+    ForwardIndex forward_index_;
+    // Порядковые номера удалённых документов, слова которых ждут пакетной очистки
+    std::vector<int> removed_ordinals_;
+    // Документы внутри сервера адресуются плотным порядковым номером: он выдаётся при добавлении
+    // и не переиспользуется. Данные документов лежат в массивах по порядковому номеру,
+    // у удалённых документов в них остаются прежние значения
+    std::unordered_map<int, int> document_ordinals_;
+    std::vector<int> ordinal_to_document_id_;
+    std::vector<int> ordinal_to_rating_;
+    std::vector<DocumentStatus> ordinal_to_status_;
+    // Тексты в document_texts_ или в снимке
+    std::vector<std::string_view> ordinal_to_text_;
+    TextArena document_texts_;
+    // id живых документов по возрастанию, для обхода сервера
     std::set<int> document_ids_;
+    // Порядковые номера живых документов по статусам
+    std::array<DocumentBitmap, DOCUMENT_STATUS_COUNT> status_documents_;
+    // Отображённый снимок, из которого загружен индекс; на него указывают terms_, сегменты и тексты.
+    // Объявлен раньше index_, чтобы пережить фоновое слияние
+    std::unique_ptr<MappedFile> snapshot_;
+    // В словопозициях и сегментах вместо id документов - порядковые номера
+    std::unique_ptr<SegmentedIndex> index_ = std::make_unique<SegmentedIndex>();
+    // Слова запроса, которые есть в живых документах, в порядке слов
+    struct QueryPlan {
+        struct PlusTerm {
+            int term_id;
+            double inverse_document_freq;
+        };
+        uint64_t version;
+        std::vector<PlusTerm> plus_terms;
+        std::vector<int> minus_terms;
+    };
+
+    struct CachedResult {
+        uint64_t version;
+        std::chrono::steady_clock::time_point expiration_time;
+        std::vector<Document> documents;
+    };
+
+    // Мьютекс кеша не перемещается, поэтому кеш в unique_ptr: SearchServer остаётся перемещаемым
+    size_t query_cache_capacity_ = 0;
+    std::unique_ptr<ShardedLruCache<QueryPlan>> query_plan_cache_ = std::make_unique<ShardedLruCache<QueryPlan>>(QUERY_CACHE_SHARD_COUNT, 0);
+    ResultCacheOptions result_cache_options_;
+    std::unique_ptr<ShardedLruCache<CachedResult>> result_cache_ = std::make_unique<ShardedLruCache<CachedResult>>(RESULT_CACHE_SHARD_COUNT, 0);
+    // nullptr, пока поиск почти одинаковых документов не включён
+    std::unique_ptr<NearDuplicateIndex> near_duplicates_;
     
     bool IsStopWord(const std::string_view word) const;
     static bool IsValidWord(const std::string_view word);
     std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
     static int ComputeAverageRating(const std::vector<int>& ratings);
+
+    // Частичный индекс одной части пакета AddDocuments, строится без обращения к основному индексу
+    struct PartialIndex {
+        std::vector<std::string_view> words;
+        std::unordered_map<std::string_view, int> word_ids;
+        // Словопозиции по локальному id слова
+        std::vector<std::vector<Posting>> postings;
+        // Для каждого документа части - пары (локальный id слова, TF)
+        std::vector<std::vector<std::pair<int, double>>> document_words;
+        std::exception_ptr error;
+    };
+
+    void ValidateNewDocumentIds(const std::vector<RawDocument>& documents) const;
+    // Документ documents[i] получит порядковый номер first_ordinal + i
+    PartialIndex BuildPartialIndex(const std::vector<RawDocument>& documents, size_t first, size_t last, int first_ordinal) const;
+    void MergePartialIndexes(const std::vector<RawDocument>& documents, const std::vector<PartialIndex>& parts);
+
+    // Порядковый номер живого документа; out_of_range, если документа нет
+    int GetDocumentOrdinal(int document_id) const;
+    int AddDocumentOrdinal(int document_id, DocumentStatus status, int rating, std::string_view text);
+
+    int GetOrAddTermId(std::string_view word);
+    // term_id слова, если оно есть хотя бы в одном живом документе, иначе -1
+    int FindTermId(std::string_view word) const;
+    void UpdateTermStatistics(int term_id, int document_count_delta);
+    // Общая часть RemoveDocument после обновления статистики слов
+    void MarkDocumentRemoved(int document_id);
+    // Освобождает прямой индекс удалённых документов и убирает из словаря слова без документов
+    void ReleaseRemovedDocuments();
+    void ReleaseRemovedDocumentsIfNeeded();
     
     struct QueryWord {
         std::string_view data;
@@ -81,21 +293,63 @@ private:
     };
     
     QueryWord ParseQueryWord(const std::string_view text) const;
+
+    void WriteSnapshot(std::ostream& output) const;
     
+    // Слова запроса упорядочены и не повторяются
     struct Query {
-        std::set<std::string_view> plus_words;
-        std::set<std::string_view> minus_words;
+        struct Word {
+            std::string_view data;
+            // -1, если слова нет ни в одном живом документе
+            int term_id;
+        };
+
+        SmallVector<Word, QUERY_INLINE_WORD_COUNT> plus_words;
+        SmallVector<Word, QUERY_INLINE_WORD_COUNT> minus_words;
     };
     
     Query ParseQuery(const std::string_view text) const;
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
-    
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    // Оставляет слова, которые есть в живых документах, и упорядочивает их по term_id,
+    // как слова документа в прямом индексе
+    static void SortQueryByTermId(Query& query);
+    // Пересекает слова запроса после SortQueryByTermId со словами документа одним слиянием
+    MatchedDocument MatchDocumentOrdinal(const Query& query, int ordinal) const;
+
+    // План из кеша, если он построен при текущем version_, иначе новый
+    std::shared_ptr<const QueryPlan> GetQueryPlan(std::string_view raw_query) const;
+    // Ключ кеша результатов: term_id запроса, статус, top_count и алгоритм, от которого
+    // зависит порядок сложения вкладов слов
+    static std::string MakeResultCacheKey(const QueryPlan& query, DocumentStatus status, int top_count, bool is_max_score);
+
+    // Документы для выдачи отбирает document_filter(ordinal): фильтр по статусу - битовая карта,
+    // произвольный предикат оборачивается в MakeDocumentFilter
+    template <typename ExecutionPolicy, typename DocumentFilter>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, const QueryPlan& query, DocumentFilter document_filter,
+                                           int top_count) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    auto MakeDocumentFilter(DocumentPredicate document_predicate) const;
+    // Живые документы со статусом; для неизвестного статуса - пустая карта
+    const DocumentBitmap& GetStatusDocuments(DocumentStatus status) const;
+    double ComputeWordInverseDocumentFreq(int term_id) const;
+    void UpdateLogDocumentCount();
+    // Тексты и слова, прочитанные из снимка, лежат не в хранилищах и в учёт удалённых не попадают
+    void ReleaseText(TextArena& texts, std::string_view text);
+    // Переносит тексты живых документов в новое хранилище, когда удалённые занимают больше половины
+    void CompactDocumentTextsIfNeeded();
+    
+    // Есть ли ordinal хотя бы в одном из списков под курсорами. Курсоры идут только вперёд,
+    // поэтому от вызова к вызову ordinal не убывает
+    static bool SkipToAny(std::vector<PostingList::Cursor>& cursors, int ordinal);
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindTopDocumentsMaxScore(const QueryPlan& query, DocumentFilter document_filter, size_t top_count) const;
+
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllDocuments(const QueryPlan& query, DocumentFilter document_filter) const;
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const QueryPlan& query, DocumentFilter document_filter) const;
+    template <typename DocumentFilter>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const QueryPlan& query, DocumentFilter document_filter) const;
 };
 
 void PrintDocument(const Document& document);
@@ -111,6 +365,7 @@ auto Paginate(const Container& c, size_t page_size);
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer& stop_words)
 : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+, stop_word_filter_(stop_words_)
 {
     using namespace std;
     if (!std::all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
@@ -118,36 +373,90 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     }
 }
 
+template <typename ExecutionPolicy>
+void SearchServer::AddDocuments(const ExecutionPolicy& policy, const std::vector<RawDocument>& documents) {
+    ValidateNewDocumentIds(documents);
+
+    const size_t max_part_count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    const size_t part_count = std::clamp<size_t>(documents.size() / MIN_DOCUMENTS_PER_PART, 1, max_part_count);
+    std::vector<PartialIndex> parts(part_count);
+    std::vector<size_t> part_numbers(part_count);
+    std::iota(part_numbers.begin(), part_numbers.end(), 0);
+    const int first_ordinal = static_cast<int>(ordinal_to_document_id_.size());
+    std::for_each(policy, part_numbers.begin(), part_numbers.end(), [&](size_t part) {
+        parts[part] = BuildPartialIndex(documents, documents.size() * part / part_count, documents.size() * (part + 1) / part_count,
+                                        first_ordinal);
+    });
+
+    MergePartialIndexes(documents, parts);
+}
+
 template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
-    
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-    
-    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     int top_count) const {
+    return FindTopDocuments(policy, *GetQueryPlan(raw_query), MakeDocumentFilter(document_predicate), top_count);
+}
+
+template <typename DocumentPredicate>
+auto SearchServer::MakeDocumentFilter(DocumentPredicate document_predicate) const {
+    return [this, document_predicate](int ordinal) {
+        return document_predicate(ordinal_to_document_id_[ordinal], ordinal_to_status_[ordinal], ordinal_to_rating_[ordinal]);
+    };
+}
+
+template <typename ExecutionPolicy, typename DocumentFilter>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, const QueryPlan& query, DocumentFilter document_filter,
+                                                     int top_count) const {
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        if (query_engine_ == QueryEngine::MAX_SCORE) {
+            return FindTopDocumentsMaxScore(query, document_filter, std::max(top_count, 0));
         }
-    });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
     
+    auto matched_documents = FindAllDocuments(policy, query, document_filter);
+    
+    // Упорядочиваем только top_count лучших документов, а не всю выдачу
+    const auto result_count = std::min(matched_documents.size(), static_cast<size_t>(std::max(top_count, 0)));
+    std::partial_sort(policy, matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(),
+                      IsMoreRelevant);
+    matched_documents.resize(result_count);
+    
     return matched_documents;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     int top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_count);
 }
 
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus status,
+                                                     int top_count) const {
+    const auto query = GetQueryPlan(raw_query);
+    auto find_documents = [&] {
+        const DocumentBitmap& status_documents = GetStatusDocuments(status);
+        return FindTopDocuments(policy, *query, [&status_documents](int ordinal) {
+            return status_documents.Contains(ordinal);
+        }, top_count);
+    };
+    if (result_cache_options_.capacity == 0) {
+        return find_documents();
+    }
+
+    const bool is_max_score = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>
+                              && query_engine_ == QueryEngine::MAX_SCORE;
+    const std::string key = MakeResultCacheKey(*query, status, top_count, is_max_score);
+    const auto now = std::chrono::steady_clock::now();
+    const auto cached_result = result_cache_->Find(key, [this, now](const CachedResult& result) {
+        return result.version == version_ && now < result.expiration_time;
     });
+    if (cached_result) {
+        return cached_result->documents;
+    }
+    auto documents = find_documents();
+    result_cache_->Insert(key, std::make_shared<CachedResult>(CachedResult{version_, now + result_cache_options_.ttl, documents}));
+    return documents;
 }
 
 template <typename ExecutionPolicy>
@@ -155,75 +464,312 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+inline bool SearchServer::SkipToAny(std::vector<PostingList::Cursor>& cursors, int ordinal) {
+    bool is_found = false;
+    for (PostingList::Cursor& cursor : cursors) {
+        cursor.SkipTo(ordinal);
+        if (!cursor.IsEnd() && cursor.GetDocumentId() == ordinal) {
+            is_found = true;
+            break;
+        }
+    }
+    return is_found;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&,const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindTopDocumentsMaxScore(const QueryPlan& query, DocumentFilter document_filter, size_t top_count) const {
+    struct TermCursor {
+        PostingList::Cursor cursor;
+        double inverse_document_freq;
+        double max_score;
+    };
+
+    std::vector<Document> top_documents;
+    if (top_count == 0) {
+        return top_documents;
+    }
+
+    double threshold = -std::numeric_limits<double>::infinity();
+    // Сегменты обходятся по очереди с общей кучей: порог, набранный в одних сегментах,
+    // сразу отсекает документы в следующих
+    for (const auto& segment : index_->GetSegments()) {
+        std::vector<TermCursor> terms;
+        for (const auto [term_id, inverse_document_freq] : query.plus_terms) {
+            const PostingList* postings = segment->FindPostings(term_id);
+            if (postings == nullptr || postings->empty()) {
+                continue;
+            }
+            terms.push_back({PostingList::Cursor(*postings), inverse_document_freq, postings->GetMaxTermFreq() * inverse_document_freq});
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        std::sort(terms.begin(), terms.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+            return lhs.max_score < rhs.max_score;
+        });
+        // max_score_prefix[i] - наибольший суммарный вклад слов terms[0..i)
+        std::vector<double> max_score_prefix(terms.size() + 1, 0.0);
+        for (size_t i = 0; i < terms.size(); ++i) {
+            max_score_prefix[i + 1] = max_score_prefix[i] + terms[i].max_score;
+        }
+
+        std::vector<PostingList::Cursor> minus_cursors;
+        for (const int term_id : query.minus_terms) {
+            if (const PostingList* postings = segment->FindPostings(term_id)) {
+                minus_cursors.emplace_back(*postings);
+            }
+        }
+
+        // Документы из списков terms[0..first_essential) сами по себе не наберут порог,
+        // поэтому кандидатов берём только из остальных ("существенных") списков
+        size_t first_essential = 0;
+        while (first_essential < terms.size() && max_score_prefix[first_essential + 1] < threshold - RELEVANCE_EPSILON) {
+            ++first_essential;
+        }
+        while (true) {
+            int ordinal = std::numeric_limits<int>::max();
+            for (size_t i = first_essential; i < terms.size(); ++i) {
+                if (!terms[i].cursor.IsEnd()) {
+                    ordinal = std::min(ordinal, terms[i].cursor.GetDocumentId());
+                }
+            }
+            if (ordinal == std::numeric_limits<int>::max()) {
+                break;
+            }
+
+            double relevance = 0.0;
+            for (size_t i = first_essential; i < terms.size(); ++i) {
+                PostingList::Cursor& cursor = terms[i].cursor;
+                if (!cursor.IsEnd() && cursor.GetDocumentId() == ordinal) {
+                    relevance += cursor.GetTermFreq() * terms[i].inverse_document_freq;
+                    cursor.Next();
+                }
+            }
+
+            if (relevance + max_score_prefix[first_essential] < threshold - RELEVANCE_EPSILON) {
+                continue;
+            }
+            if (segment->IsDeleted(ordinal)) {
+                continue;
+            }
+            if (!document_filter(ordinal)) {
+                continue;
+            }
+            if (SkipToAny(minus_cursors, ordinal)) {
+                continue;
+            }
+
+            bool is_pruned = false;
+            for (size_t i = first_essential; i-- > 0;) {
+                if (relevance + max_score_prefix[i + 1] < threshold - RELEVANCE_EPSILON) {
+                    is_pruned = true;
+                    break;
+                }
+                PostingList::Cursor& cursor = terms[i].cursor;
+                cursor.SkipTo(ordinal);
+                if (!cursor.IsEnd() && cursor.GetDocumentId() == ordinal) {
+                    relevance += cursor.GetTermFreq() * terms[i].inverse_document_freq;
+                }
+            }
+            if (is_pruned) {
+                continue;
+            }
+
+            // top_documents - куча, в вершине которой худший из отобранных документов
+            const Document document(ordinal_to_document_id_[ordinal], relevance, ordinal_to_rating_[ordinal]);
+            if (top_documents.size() < top_count) {
+                top_documents.push_back(document);
+                std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+            } else if (IsMoreRelevant(document, top_documents.front())) {
+                std::pop_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+                top_documents.back() = document;
+                std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+            }
+            if (top_documents.size() == top_count) {
+                threshold = top_documents.front().relevance;
+                while (first_essential < terms.size() && max_score_prefix[first_essential + 1] < threshold - RELEVANCE_EPSILON) {
+                    ++first_essential;
+                }
             }
         }
     }
-    
-    for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+
+    std::sort_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+    return top_documents;
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllDocuments(const QueryPlan& query, DocumentFilter document_filter) const {
+    return FindAllDocuments(std::execution::seq, query, document_filter);
+}
+
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const QueryPlan& query, DocumentFilter document_filter) const {
+    // Буфер подсчёта свой у каждого потока и переживает запросы
+    RelevanceAccumulator& document_to_relevance = RelevanceAccumulator::ForCurrentThread();
+    document_to_relevance.Reset(ordinal_to_document_id_.size());
+    std::vector<const PostingList*> long_minus_postings;
+    std::vector<PostingList::Cursor> minus_cursors;
+    for (const auto& segment : index_->GetSegments()) {
+        size_t plus_posting_count = 0;
+        for (const auto [term_id, _] : query.plus_terms) {
+            if (const PostingList* postings = segment->FindPostings(term_id)) {
+                plus_posting_count += postings->size();
+            }
+        }
+        if (plus_posting_count == 0) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+
+        // Документы с минус-словами отсеиваем до подсчёта. Короткий список минус-слова целиком
+        // отмечаем в накопителе, а длинный вычитаем из каждого списка плюс-слова: его курсор
+        // догоняет очередной документ скачками
+        long_minus_postings.clear();
+        for (const int term_id : query.minus_terms) {
+            const PostingList* postings = segment->FindPostings(term_id);
+            if (postings == nullptr) {
+                continue;
+            }
+            if (postings->size() > plus_posting_count * MIN_MINUS_POSTINGS_RATIO_FOR_SKIPS) {
+                long_minus_postings.push_back(postings);
+                continue;
+            }
+            postings->ForEach([&](const Posting& posting) {
+                document_to_relevance.Exclude(posting.document_id);
+            });
+        }
+
+        for (const auto [term_id, inverse_document_freq] : query.plus_terms) {
+            const PostingList* postings = segment->FindPostings(term_id);
+            if (postings == nullptr) {
+                continue;
+            }
+            minus_cursors.clear();
+            for (const PostingList* minus_postings : long_minus_postings) {
+                minus_cursors.emplace_back(*minus_postings);
+            }
+            postings->ForEach([&](const Posting& posting) {
+                const int ordinal = posting.document_id;
+                if (segment->IsDeleted(ordinal) || !document_filter(ordinal)) {
+                    return;
+                }
+                if (!minus_cursors.empty() && SkipToAny(minus_cursors, ordinal)) {
+                    return;
+                }
+                document_to_relevance.Add(ordinal, posting.term_freq * inverse_document_freq);
+            });
         }
     }
     
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
-    }
+    document_to_relevance.ForEach([&](size_t ordinal, double relevance) {
+        matched_documents.push_back({ordinal_to_document_id_[ordinal], relevance, ordinal_to_rating_[ordinal]});
+    });
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(100);
-    for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(),
-            [this, document_predicate, &document_to_relevance](std::string_view word) {
-                if (word_to_document_freqs_.count(word) == 0) {
-                    return;
-                }
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
-                }
+template <typename DocumentFilter>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const QueryPlan& query, DocumentFilter document_filter) const {
+    struct TermPostings {
+        const IndexSegment* segment;
+        const PostingList* postings;
+        double inverse_document_freq;
+    };
+    // Ссылки на сегменты держим до конца подсчёта, даже если фоновое слияние их заменит
+    const auto segments = index_->GetSegments();
+    std::vector<TermPostings> plus_terms;
+    // Списки минус-слов делятся как в последовательном подсчёте: короткие отмечаются в накопителе
+    // заранее, длинные вычитаются из списков плюс-слов своего сегмента
+    std::vector<TermPostings> minus_terms;
+    std::vector<TermPostings> long_minus_terms;
+    const PostingList* longest_postings = nullptr;
+    size_t posting_count = 0;
+    for (const auto& segment : segments) {
+        const size_t segment_first_posting = posting_count;
+        for (const auto [term_id, inverse_document_freq] : query.plus_terms) {
+            const PostingList* postings = segment->FindPostings(term_id);
+            if (postings == nullptr || postings->empty()) {
+                continue;
+            }
+            plus_terms.push_back({segment.get(), postings, inverse_document_freq});
+            posting_count += postings->size();
+            if (longest_postings == nullptr || postings->size() > longest_postings->size()) {
+                longest_postings = postings;
+            }
+        }
+        const size_t plus_posting_count = posting_count - segment_first_posting;
+        if (plus_posting_count == 0) {
+            continue;
+        }
+        for (const int term_id : query.minus_terms) {
+            if (const PostingList* postings = segment->FindPostings(term_id)) {
+                (postings->size() > plus_posting_count * MIN_MINUS_POSTINGS_RATIO_FOR_SKIPS ? long_minus_terms : minus_terms)
+                    .push_back({segment.get(), postings, 0.0});
             }
-    );
+        }
+    }
+    if (plus_terms.empty()) {
+        return {};
+    }
 
-    for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-            [this, &document_to_relevance](std::string_view word) {
-                if (word_to_document_freqs_.count(word) == 0) {
-                    return;
+    // Делим пространство порядковых номеров на диапазоны, каждый диапазон считается целиком в одном потоке
+    // со своим накопителем, поэтому блокировки не нужны. Границы берём из самого длинного
+    // списка, чтобы объём работы в частях был примерно равным
+    const size_t max_part_count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    const size_t part_count = std::clamp<size_t>(posting_count / MIN_POSTINGS_PER_PART, 1, max_part_count);
+    std::vector<int> part_bounds(part_count + 1);
+    part_bounds.front() = 0;
+    part_bounds.back() = std::numeric_limits<int>::max();
+    for (size_t part = 1; part < part_count; ++part) {
+        part_bounds[part] = longest_postings->SampleDocumentId(longest_postings->size() * part / part_count);
+    }
+
+    std::vector<std::vector<Document>> part_documents(part_count);
+    std::vector<size_t> parts(part_count);
+    std::iota(parts.begin(), parts.end(), 0);
+    std::for_each(std::execution::par, parts.begin(), parts.end(), [&](size_t part) {
+        const int first_ordinal = part_bounds[part];
+        const int last_ordinal = part_bounds[part + 1];
+        if (first_ordinal >= last_ordinal) {
+            return;
+        }
+        RelevanceAccumulator& document_to_relevance = RelevanceAccumulator::ForCurrentThread();
+        document_to_relevance.Reset(ordinal_to_document_id_.size());
+        for (const auto [segment, postings, _] : minus_terms) {
+            PostingList::Cursor cursor(*postings);
+            for (cursor.SkipTo(first_ordinal); !cursor.IsEnd() && cursor.GetDocumentId() < last_ordinal; cursor.Next()) {
+                document_to_relevance.Exclude(cursor.GetDocumentId());
+            }
+        }
+        std::vector<PostingList::Cursor> minus_cursors;
+        for (const auto [segment, postings, inverse_document_freq] : plus_terms) {
+            minus_cursors.clear();
+            for (const TermPostings& minus_term : long_minus_terms) {
+                if (minus_term.segment == segment) {
+                    minus_cursors.emplace_back(*minus_term.postings);
+                }
+            }
+            PostingList::Cursor cursor(*postings);
+            for (cursor.SkipTo(first_ordinal); !cursor.IsEnd() && cursor.GetDocumentId() < last_ordinal; cursor.Next()) {
+                const int ordinal = cursor.GetDocumentId();
+                if (segment->IsDeleted(ordinal) || !document_filter(ordinal)) {
+                    continue;
                 }
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.erase(document_id);
+                if (!minus_cursors.empty() && SkipToAny(minus_cursors, ordinal)) {
+                    continue;
                 }
+                document_to_relevance.Add(ordinal, cursor.GetTermFreq() * inverse_document_freq);
             }
-    );
+        }
+        document_to_relevance.ForEach([&](size_t ordinal, double relevance) {
+            part_documents[part].push_back({ordinal_to_document_id_[ordinal], relevance, ordinal_to_rating_[ordinal]});
+        });
+    });
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    std::vector<size_t> part_offsets(part_count + 1, 0);
+    for (size_t part = 0; part < part_count; ++part) {
+        part_offsets[part + 1] = part_offsets[part] + part_documents[part].size();
     }
+    std::vector<Document> matched_documents(part_offsets.back());
+    std::for_each(std::execution::par, parts.begin(), parts.end(), [&](size_t part) {
+        std::copy(part_documents[part].begin(), part_documents[part].end(), matched_documents.begin() + part_offsets[part]);
+    });
     return matched_documents;
-}
\ No newline at end of file
+}
@@ -0,0 +1,994 @@
+#include "search_server_tests.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "concurrent_search_server.h"
+#include "lru_cache.h"
+#include "relevance_accumulator.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+#include "stop_word_filter.h"
+#include "string_processing.h"
+
+using namespace std;
+
+namespace {
+
+const int TEST_DOCUMENT_COUNT = 4'000;
+const int TEST_WORD_COUNT = 400;
+const int TEST_QUERY_COUNT = 60;
+const string TEST_STOP_WORDS = "and w1"s;
+// Редкое слово есть в каждом RARE_WORD_PERIOD-м документе, частое - во всех, кроме каждого седьмого.
+// Запрос "rare -common" идёт по пути, где длинный минус-список пропускается скачками курсора
+const int RARE_WORD_PERIOD = 400;
+
+string GetTestWord(mt19937& generator) {
+    // Частота слов убывает к концу словаря, как в настоящих текстах
+    const double position = pow(uniform_real_distribution<>(0.0, 1.0)(generator), 3);
+    return "w"s + to_string(static_cast<int>(position * (TEST_WORD_COUNT - 1)));
+}
+
+vector<string> GenerateTestDocuments(mt19937& generator) {
+    vector<string> documents;
+    for (int i = 0; i < TEST_DOCUMENT_COUNT; ++i) {
+        string text = GetTestWord(generator);
+        const int word_count = uniform_int_distribution(4, 16)(generator);
+        for (int j = 1; j < word_count; ++j) {
+            text += ' ' + GetTestWord(generator);
+        }
+        if (i % RARE_WORD_PERIOD == 0) {
+            text += " rare"s;
+        }
+        if (i % 7 != 0) {
+            text += " common"s;
+        }
+        documents.push_back(move(text));
+    }
+    return documents;
+}
+
+vector<string> GenerateTestQueries(mt19937& generator) {
+    vector<string> queries = {"rare -common"s, "rare common -w0"s, "common -rare"s, "w1 rare"s, "nothing"s};
+    while (queries.size() < static_cast<size_t>(TEST_QUERY_COUNT)) {
+        string query = GetTestWord(generator);
+        const int word_count = uniform_int_distribution(1, 6)(generator);
+        for (int i = 1; i < word_count; ++i) {
+            query += ' ' + GetTestWord(generator);
+        }
+        if (queries.size() % 3 == 0) {
+            query += " -"s + GetTestWord(generator);
+        }
+        queries.push_back(move(query));
+    }
+    return queries;
+}
+
+DocumentStatus GetTestStatus(int document_id) {
+    return document_id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+}
+
+void AddTestDocuments(SearchServer& server, const vector<string>& documents) {
+    for (int i = 0; i < static_cast<int>(documents.size()); ++i) {
+        server.AddDocument(i, documents[i], GetTestStatus(i), {i % 10, 1});
+    }
+}
+
+// Все найденные документы любого статуса с их релевантностью
+map<int, double> FindAllRelevances(const SearchServer& server, const string& query) {
+    map<int, double> relevances;
+    const auto all_documents = [](int, DocumentStatus, int) {
+        return true;
+    };
+    for (const Document& document : server.FindTopDocuments(query, all_documents, server.GetDocumentCount())) {
+        relevances[document.id] = document.relevance;
+    }
+    return relevances;
+}
+
+void AssertSameRelevances(const map<int, double>& expected, const map<int, double>& found, double tolerance) {
+    assert(expected.size() == found.size());
+    for (const auto& [document_id, relevance] : expected) {
+        const auto it = found.find(document_id);
+        assert(it != found.end());
+        assert(abs(it->second - relevance) < tolerance);
+    }
+}
+
+// TF-IDF по определению: TF слов каждого документа считается по его тексту
+class ReferenceIndex {
+public:
+    ReferenceIndex(const vector<string>& documents, const string& stop_words)
+    : stop_words_(MakeWordSet(stop_words)) {
+        for (const string& document : documents) {
+            map<string, double> term_freqs;
+            const auto words = SplitIntoWords(document);
+            int word_count = 0;
+            for (const string_view word : words) {
+                if (stop_words_.count(string(word)) == 0) {
+                    ++word_count;
+                }
+            }
+            for (const string_view word : words) {
+                if (stop_words_.count(string(word)) == 0) {
+                    term_freqs[string(word)] += 1.0 / word_count;
+                }
+            }
+            for (const auto& [word, term_freq] : term_freqs) {
+                ++document_freqs_[word];
+            }
+            term_freqs_.push_back(move(term_freqs));
+        }
+    }
+
+    map<int, double> FindAllRelevances(const string& query) const {
+        const auto [plus_words, minus_words] = ParseQuery(query);
+        map<int, double> relevances;
+        for (int document_id = 0; document_id < static_cast<int>(term_freqs_.size()); ++document_id) {
+            const auto& term_freqs = term_freqs_[document_id];
+            if (any_of(minus_words.begin(), minus_words.end(), [&term_freqs](const string& word) {
+                    return term_freqs.count(word) > 0;
+                })) {
+                continue;
+            }
+            for (const string& word : plus_words) {
+                if (const auto it = term_freqs.find(word); it != term_freqs.end()) {
+                    relevances[document_id] += it->second * log(static_cast<double>(term_freqs_.size()) / document_freqs_.at(word));
+                }
+            }
+        }
+        return relevances;
+    }
+
+    // Слова запроса из документа по алфавиту; пусто, если в документе есть минус-слово
+    vector<string> MatchDocument(const string& query, int document_id) const {
+        const auto [plus_words, minus_words] = ParseQuery(query);
+        const auto& term_freqs = term_freqs_[document_id];
+        vector<string> words;
+        for (const string& word : minus_words) {
+            if (term_freqs.count(word) > 0) {
+                return {};
+            }
+        }
+        for (const string& word : plus_words) {
+            if (term_freqs.count(word) > 0) {
+                words.push_back(word);
+            }
+        }
+        return words;
+    }
+
+private:
+    set<string> stop_words_;
+    vector<map<string, double>> term_freqs_;
+    map<string, int> document_freqs_;
+
+    static set<string> MakeWordSet(const string& text) {
+        set<string> words;
+        for (const string_view word : SplitIntoWords(text)) {
+            words.emplace(word);
+        }
+        return words;
+    }
+
+    pair<set<string>, set<string>> ParseQuery(const string& query) const {
+        set<string> plus_words;
+        set<string> minus_words;
+        for (string_view word : SplitIntoWords(query)) {
+            const bool is_minus = word[0] == '-';
+            if (is_minus) {
+                word.remove_prefix(1);
+            }
+            if (stop_words_.count(string(word)) == 0) {
+                (is_minus ? minus_words : plus_words).emplace(word);
+            }
+        }
+        return {plus_words, minus_words};
+    }
+};
+
+void TestFlatIndexMatchesReference(const SearchServer& server, const vector<string>& documents, const vector<string>& queries) {
+    const ReferenceIndex reference(documents, TEST_STOP_WORDS);
+    for (const string& query : queries) {
+        AssertSameRelevances(reference.FindAllRelevances(query), FindAllRelevances(server, query), RELEVANCE_EPSILON);
+        for (int document_id = 0; document_id < static_cast<int>(documents.size()); document_id += 37) {
+            const auto [words, status] = server.MatchDocument(query, document_id);
+            assert(vector<string>(words.begin(), words.end()) == reference.MatchDocument(query, document_id));
+            assert(status == GetTestStatus(document_id));
+        }
+    }
+}
+
+void TestCompressedMatchesPlain(const SearchServer& plain_server, const vector<string>& documents, const vector<string>& queries) {
+    // Часть словопозиций сжатого сервера остаётся в несжатом хвосте списка
+    SearchServer compressed_server(TEST_STOP_WORDS);
+    compressed_server.SetPostingFormat(PostingFormat::COMPRESSED);
+    AddTestDocuments(compressed_server, documents);
+
+    // TF в сжатом формате округлён до 1/65535, релевантность отличается не больше чем на IDF * 1e-5 на слово
+    const double tolerance = 1e-3;
+    for (const string& query : queries) {
+        AssertSameRelevances(FindAllRelevances(plain_server, query), FindAllRelevances(compressed_server, query), tolerance);
+    }
+
+    // Одинаковые документы получают одинаковую релевантность и в блоке, и в хвосте
+    SearchServer server("and"s);
+    server.SetPostingFormat(PostingFormat::COMPRESSED);
+    for (int i = 0; i < 1'000; ++i) {
+        server.AddDocument(i, "alpha beta gamma delta epsilon zeta eta"s, DocumentStatus::ACTUAL, {1});
+    }
+    for (int i = 1'000; i < 3'000; ++i) {
+        server.AddDocument(i, "other"s, DocumentStatus::ACTUAL, {1});
+    }
+    const auto relevances = FindAllRelevances(server, "alpha"s);
+    assert(relevances.size() == 1'000);
+    for (const auto& [document_id, relevance] : relevances) {
+        assert(relevance == relevances.begin()->second);
+    }
+    for (const QueryEngine engine : {QueryEngine::EXHAUSTIVE, QueryEngine::MAX_SCORE}) {
+        server.SetQueryEngine(engine);
+        const auto top = server.FindTopDocuments("alpha"s);
+        for (size_t i = 0; i < top.size(); ++i) {
+            assert(top[i].id == static_cast<int>(i));
+        }
+    }
+}
+
+// Выдача совпадает с эталонной по релевантности на каждом месте, а у документов
+// с равной релевантностью порядок может отличаться
+void AssertSameTop(const vector<Document>& expected, const vector<Document>& found, const map<int, double>& relevances) {
+    assert(expected.size() == found.size());
+    for (size_t i = 0; i < found.size(); ++i) {
+        assert(abs(expected[i].relevance - found[i].relevance) < RELEVANCE_EPSILON);
+        assert(abs(relevances.at(found[i].id) - found[i].relevance) < RELEVANCE_EPSILON);
+    }
+}
+
+void TestMaxScoreMatchesExhaustive(SearchServer& server, const vector<string>& queries) {
+    const auto even_ids = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    };
+    for (const string& query : queries) {
+        server.SetQueryEngine(QueryEngine::EXHAUSTIVE);
+        const auto relevances = FindAllRelevances(server, query);
+        const auto expected_top = server.FindTopDocuments(query);
+        const auto expected_wide = server.FindTopDocuments(query, DocumentStatus::BANNED, 50);
+        const auto expected_even = server.FindTopDocuments(query, even_ids, 20);
+
+        server.SetQueryEngine(QueryEngine::MAX_SCORE);
+        AssertSameTop(expected_top, server.FindTopDocuments(query), relevances);
+        AssertSameTop(expected_wide, server.FindTopDocuments(query, DocumentStatus::BANNED, 50), relevances);
+        AssertSameTop(expected_even, server.FindTopDocuments(query, even_ids, 20), relevances);
+    }
+}
+
+void TestParallelMatchesSequential(SearchServer& server, const vector<string>& queries) {
+    const auto rating_filter = [](int, DocumentStatus, int rating) {
+        return rating >= 3;
+    };
+    for (const QueryEngine engine : {QueryEngine::EXHAUSTIVE, QueryEngine::MAX_SCORE}) {
+        server.SetQueryEngine(engine);
+        for (const string& query : queries) {
+            const auto relevances = FindAllRelevances(server, query);
+            AssertSameTop(server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, 30),
+                          server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, 30), relevances);
+            AssertSameTop(server.FindTopDocuments(execution::seq, query, rating_filter),
+                          server.FindTopDocuments(execution::par, query, rating_filter), relevances);
+        }
+    }
+}
+
+vector<RawDocument> MakeRawDocuments(const vector<string>& documents, int first, int last) {
+    vector<RawDocument> raw_documents;
+    for (int i = first; i < last; ++i) {
+        raw_documents.push_back({i, documents[i], GetTestStatus(i), {i % 10, 1}});
+    }
+    return raw_documents;
+}
+
+void AssertSameIndex(const SearchServer& expected, const SearchServer& found, const vector<string>& queries) {
+    assert(expected.GetDocumentCount() == found.GetDocumentCount());
+    assert(equal(expected.begin(), expected.end(), found.begin(), found.end()));
+    for (const string& query : queries) {
+        AssertSameRelevances(FindAllRelevances(expected, query), FindAllRelevances(found, query), RELEVANCE_EPSILON);
+    }
+    for (const int document_id : expected) {
+        assert(expected.GetWordFrequenciesMap(document_id) == found.GetWordFrequenciesMap(document_id));
+    }
+}
+
+template <typename ExecutionPolicy>
+void TestBatchAddMatchesSequential(const ExecutionPolicy& policy, const SearchServer& sequential_server, const vector<string>& documents,
+                                   const vector<string>& queries) {
+    // Второй пакет добавляется к уже непустому индексу и частично повторяет его слова
+    SearchServer batch_server(TEST_STOP_WORDS);
+    const int half = static_cast<int>(documents.size()) / 2;
+    batch_server.AddDocuments(policy, MakeRawDocuments(documents, 0, half));
+    batch_server.AddDocuments(policy, MakeRawDocuments(documents, half, static_cast<int>(documents.size())));
+    AssertSameIndex(sequential_server, batch_server, queries);
+}
+
+void TestBatchAddRejectsInvalidDocuments(const vector<string>& documents, const vector<string>& queries) {
+    SearchServer server(TEST_STOP_WORDS);
+    server.AddDocuments(MakeRawDocuments(documents, 0, 100));
+    SearchServer expected_server(TEST_STOP_WORDS);
+    AddTestDocuments(expected_server, vector(documents.begin(), documents.begin() + 100));
+
+    auto duplicate_in_batch = MakeRawDocuments(documents, 100, 200);
+    duplicate_in_batch.back().id = 150;
+    auto duplicate_in_index = MakeRawDocuments(documents, 100, 200);
+    duplicate_in_index[50].id = 7;
+    auto negative_id = MakeRawDocuments(documents, 100, 200);
+    negative_id[10].id = -1;
+    auto control_character = MakeRawDocuments(documents, 100, 200);
+    const string invalid_text = "w2 w\x12x w3"s;
+    control_character[99].text = invalid_text;
+    // Ошибка в одном документе отменяет весь пакет, в том числе уже разобранные части
+    for (const auto* batch : {&duplicate_in_batch, &duplicate_in_index, &negative_id, &control_character}) {
+        for (const bool is_parallel : {false, true}) {
+            bool is_rejected = false;
+            try {
+                if (is_parallel) {
+                    server.AddDocuments(execution::par, *batch);
+                } else {
+                    server.AddDocuments(execution::seq, *batch);
+                }
+            } catch (const invalid_argument&) {
+                is_rejected = true;
+            }
+            assert(is_rejected);
+            AssertSameIndex(expected_server, server, queries);
+        }
+    }
+
+    server.AddDocuments(MakeRawDocuments(documents, 100, 200));
+    for (int i = 100; i < 200; ++i) {
+        expected_server.AddDocument(i, documents[i], GetTestStatus(i), {i % 10, 1});
+    }
+    AssertSameIndex(expected_server, server, queries);
+}
+
+void TestSnapshotRoundTrip(const SearchServer& server, const vector<string>& queries) {
+    const string path = (filesystem::temp_directory_path() / "search_server_test.snapshot").string();
+    server.SaveSnapshot(path);
+    {
+        SearchServer loaded_server = SearchServer::LoadSnapshot(path);
+        assert(loaded_server.GetDocumentCount() == server.GetDocumentCount());
+        for (const string& query : queries) {
+            AssertSameRelevances(FindAllRelevances(server, query), FindAllRelevances(loaded_server, query), RELEVANCE_EPSILON);
+        }
+
+        // Сохранение поверх снимка, из которого сервер загружен
+        loaded_server.AddDocument(TEST_DOCUMENT_COUNT, "rare common w2"s, DocumentStatus::ACTUAL, {5});
+        loaded_server.SaveSnapshot(path);
+        SearchServer reloaded_server = SearchServer::LoadSnapshot(path);
+        assert(reloaded_server.GetDocumentCount() == server.GetDocumentCount() + 1);
+        for (const string& query : queries) {
+            AssertSameRelevances(FindAllRelevances(loaded_server, query), FindAllRelevances(reloaded_server, query), RELEVANCE_EPSILON);
+        }
+    }
+    remove(path.c_str());
+}
+
+void TestSegmentMerges(const vector<string>& documents, const vector<string>& queries) {
+    // Мелкие сегменты записи с удалениями и фоновым слиянием против одного сегмента без удалённых
+    SearchServer segmented_server(TEST_STOP_WORDS);
+    segmented_server.SetWriteSegmentSize(64);
+    AddTestDocuments(segmented_server, documents);
+    SearchServer expected_server(TEST_STOP_WORDS);
+    for (int i = 0; i < static_cast<int>(documents.size()); ++i) {
+        if (i % 3 == 0) {
+            segmented_server.RemoveDocument(i);
+        } else {
+            expected_server.AddDocument(i, documents[i], GetTestStatus(i), {i % 10, 1});
+        }
+    }
+    assert(segmented_server.GetDocumentCount() == expected_server.GetDocumentCount());
+
+    // Сначала удалённые ещё лежат в сегментах и отсеиваются по карте удалений, потом их выбрасывает слияние
+    expected_server.SetQueryEngine(QueryEngine::EXHAUSTIVE);
+    for (const bool cleaned_up : {false, true}) {
+        if (cleaned_up) {
+            segmented_server.CleanupRemovedDocuments();
+        }
+        for (const string& query : queries) {
+            const auto relevances = FindAllRelevances(expected_server, query);
+            AssertSameRelevances(relevances, FindAllRelevances(segmented_server, query), RELEVANCE_EPSILON);
+            AssertSameTop(expected_server.FindTopDocuments(query), segmented_server.FindTopDocuments(query), relevances);
+            AssertSameTop(expected_server.FindTopDocuments(query), segmented_server.FindTopDocuments(execution::par, query),
+                          relevances);
+        }
+    }
+}
+
+void TestConcurrentMatchOwnsWords() {
+    // Слова результата не должны зависеть от копий сервера, которые меняются после выхода читателей
+    ConcurrentSearchServer server(TEST_STOP_WORDS);
+    server.AddDocument(1, "unique rare words"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "common words"s, DocumentStatus::ACTUAL, {1});
+    const auto [words, status] = server.MatchDocument("unique rare"s, 1);
+    const vector<int> document_ids = {1, 2};
+    const auto matched_documents = server.MatchDocuments("words unique"s, document_ids);
+
+    server.RemoveDocument(1);
+    server.CleanupRemovedDocuments();
+    for (int i = 0; i < 100; ++i) {
+        server.AddDocument(100 + i, "filler"s + to_string(i), DocumentStatus::ACTUAL, {1});
+    }
+    server.CleanupRemovedDocuments();
+
+    assert(status == DocumentStatus::ACTUAL);
+    assert((words == vector<string>{"rare"s, "unique"s}));
+    assert((get<0>(matched_documents[0]) == vector<string>{"unique"s, "words"s}));
+    assert((get<0>(matched_documents[1]) == vector<string>{"words"s}));
+}
+
+void TestTermCompaction() {
+    SearchServer server(TEST_STOP_WORDS);
+    server.AddDocument(1, "unique rare words"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "common words"s, DocumentStatus::ACTUAL, {1});
+    const string query = "unique rare words"s;
+    const auto [words, status] = server.MatchDocument(query, 1);
+    const auto word_frequencies = server.GetWordFrequenciesMap(1);
+
+    // Освобождённых слов набирается на несколько блоков хранилища, но без явного вызова
+    // словарь не переносится, и полученные раньше слова остаются на месте
+    server.RemoveDocument(1);
+    const string long_word(64, 'x');
+    for (int round = 0; round < 2; ++round) {
+        const int first_id = 100 + round * 20000;
+        for (int i = 0; i < 20000; ++i) {
+            server.AddDocument(first_id + i, long_word + to_string(i), DocumentStatus::ACTUAL, {1});
+        }
+        for (int i = 0; i < 20000; ++i) {
+            server.RemoveDocument(first_id + i);
+        }
+        server.CleanupRemovedDocuments();
+    }
+    assert(status == DocumentStatus::ACTUAL);
+    assert((words == vector<string_view>{"rare"sv, "unique"sv, "words"sv}));
+    vector<string_view> frequency_words;
+    for (const auto& [word, term_freq] : word_frequencies) {
+        frequency_words.push_back(word);
+    }
+    assert((frequency_words == vector<string_view>{"rare"sv, "unique"sv, "words"sv}));
+
+    server.CompactTermTexts();
+    const string new_word = long_word + "0"s;
+    server.AddDocument(3, "unique "s + new_word, DocumentStatus::ACTUAL, {1});
+    assert(server.GetDocumentCount() == 2);
+    assert(get<0>(server.MatchDocument(query, 2)) == vector<string_view>{"words"sv});
+    const string new_query = "unique "s + new_word;
+    assert((get<0>(server.MatchDocument(new_query, 3)) == vector<string_view>{"unique"sv, new_word}));
+    assert(server.FindTopDocuments("unique"s).size() == 1);
+    assert(server.FindTopDocuments(new_word).size() == 1);
+}
+
+// Документы из слов маленького словаря: много одинаковых наборов слов в разном порядке
+// и с разными частотами
+vector<string> GenerateDuplicateCandidates(mt19937& generator) {
+    vector<string> documents;
+    for (int i = 0; i < 600; ++i) {
+        vector<string> words;
+        const int word_count = uniform_int_distribution(1, 4)(generator);
+        for (int j = 0; j < word_count; ++j) {
+            words.push_back("d"s + to_string(uniform_int_distribution(0, 5)(generator)));
+        }
+        if (i > 0 && i % 4 == 0) {
+            // Слова уже добавленного документа в другом порядке и с повторами
+            istringstream input(documents[uniform_int_distribution(0, i - 1)(generator)]);
+            words.assign(istream_iterator<string>(input), istream_iterator<string>());
+            words.push_back(words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)]);
+            shuffle(words.begin(), words.end(), generator);
+        }
+        string document;
+        for (const string& word : words) {
+            document += (document.empty() ? ""s : " "s) + word;
+        }
+        documents.push_back(document);
+    }
+    return documents;
+}
+
+// Дубликаты по определению: документ, набор слов которого уже встречался у меньшего id
+vector<int> FindDuplicatesBySets(const SearchServer& server) {
+    set<set<string>> word_sets;
+    vector<int> duplicate_ids;
+    for (const int document_id : server) {
+        set<string> words;
+        for (const auto& [word, term_freq] : server.GetWordFrequencies(document_id)) {
+            words.emplace(word);
+        }
+        if (!word_sets.insert(words).second) {
+            duplicate_ids.push_back(document_id);
+        }
+    }
+    return duplicate_ids;
+}
+
+void TestRemoveDuplicatesMatchesSets(mt19937& generator) {
+    const auto documents = GenerateDuplicateCandidates(generator);
+    SearchServer server(TEST_STOP_WORDS);
+    for (int i = 0; i < static_cast<int>(documents.size()); ++i) {
+        server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1});
+    }
+    const auto expected = FindDuplicatesBySets(server);
+    assert(!expected.empty());
+    assert(FindDuplicates(server) == expected);
+    assert(FindDuplicates(execution::par, server) == expected);
+
+    // Одинаковые отпечатки у всех документов и у документов с одним числом слов:
+    // дубликаты должны отбираться сравнением наборов, а не отпечатками
+    vector<pair<DocumentFingerprint, int>> same_fingerprints;
+    vector<pair<DocumentFingerprint, int>> size_fingerprints;
+    for (const int document_id : server) {
+        same_fingerprints.push_back({DocumentFingerprint{}, document_id});
+        size_fingerprints.push_back({DocumentFingerprint{server.GetWordFrequencies(document_id).size(), 0}, document_id});
+    }
+    sort(size_fingerprints.begin(), size_fingerprints.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+    });
+    assert(VerifyFingerprintCollisions(server, same_fingerprints) == expected);
+    assert(VerifyFingerprintCollisions(server, size_fingerprints) == expected);
+
+    // RemoveDuplicates печатает найденные id; в проверках вывод не нужен
+    ostringstream output;
+    streambuf* const cout_buffer = cout.rdbuf(output.rdbuf());
+    RemoveDuplicates(execution::par, server);
+    cout.rdbuf(cout_buffer);
+    assert(static_cast<size_t>(server.GetDocumentCount()) == documents.size() - expected.size());
+    for (const int document_id : expected) {
+        assert(server.GetWordFrequencies(document_id).size() == 0);
+    }
+    assert(FindDuplicatesBySets(server).empty());
+}
+
+string JoinWords(const string& prefix, int first, int last) {
+    string text;
+    for (int i = first; i < last; ++i) {
+        text += (text.empty() ? ""s : " "s) + prefix + to_string(i);
+    }
+    return text;
+}
+
+void TestNearDuplicates() {
+    SearchServer server(TEST_STOP_WORDS);
+    const string base = JoinWords("n"s, 0, 20);
+    server.AddDocument(1, base, DocumentStatus::ACTUAL, {1});
+    // Тот же набор слов в другом порядке
+    server.AddDocument(2, JoinWords("n"s, 10, 20) + " "s + JoinWords("n"s, 0, 10), DocumentStatus::ACTUAL, {1});
+    server.EnableNearDuplicateDetection(0.8);
+    // Одно слово заменено: коэффициент Жаккара 19/21
+    server.AddDocument(3, JoinWords("n"s, 0, 19) + " other"s, DocumentStatus::ACTUAL, {1});
+    // Половина слов общая: 10/30, ниже порога
+    server.AddDocument(4, JoinWords("n"s, 0, 10) + " "s + JoinWords("m"s, 0, 10), DocumentStatus::ACTUAL, {1});
+    server.AddDocument(5, JoinWords("u"s, 0, 20), DocumentStatus::ACTUAL, {1});
+
+    assert((server.FindNearDuplicates(1) == vector<int>{2, 3}));
+    assert((server.FindNearDuplicates(3) == vector<int>{1, 2}));
+    assert(server.FindNearDuplicates(4).empty());
+    assert(server.FindNearDuplicates(5).empty());
+
+    // Удалённый документ пропадает из кандидатов, добавленный заново - возвращается
+    server.RemoveDocument(2);
+    assert((server.FindNearDuplicates(1) == vector<int>{3}));
+    try {
+        server.FindNearDuplicates(2);
+        assert(false);
+    } catch (const out_of_range&) {
+    }
+    server.AddDocument(6, base, DocumentStatus::ACTUAL, {1});
+    assert((server.FindNearDuplicates(1) == vector<int>{3, 6}));
+
+    // Случайные документы: всё, что похоже не меньше чем на 0.9, должно найтись, а найденное -
+    // быть похоже не меньше чем на порог
+    mt19937 generator;
+    for (int i = 0; i < 300; ++i) {
+        set<int> words;
+        while (words.size() < 12) {
+            words.insert(uniform_int_distribution(0, 14)(generator));
+        }
+        string text;
+        for (const int word : words) {
+            text += "r"s + to_string(word) + " "s;
+        }
+        text.pop_back();
+        server.AddDocument(100 + i, text, DocumentStatus::ACTUAL, {1});
+    }
+    for (const int document_id : server) {
+        const auto found = server.FindNearDuplicates(document_id);
+        for (const int other_id : server) {
+            if (other_id == document_id) {
+                continue;
+            }
+            set<string_view> lhs;
+            set<string_view> rhs;
+            for (const auto& [word, term_freq] : server.GetWordFrequencies(document_id)) {
+                lhs.insert(word);
+            }
+            for (const auto& [word, term_freq] : server.GetWordFrequencies(other_id)) {
+                rhs.insert(word);
+            }
+            vector<string_view> common;
+            set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), back_inserter(common));
+            const double similarity = static_cast<double>(common.size()) / (lhs.size() + rhs.size() - common.size());
+            const bool is_found = binary_search(found.begin(), found.end(), other_id);
+            assert(!is_found || similarity >= 0.8);
+            assert(is_found || similarity < 0.9);
+        }
+    }
+
+    // Документ удаляется, если похожий на него с меньшим id остался, поэтому среди оставшихся похожих нет
+    ostringstream output;
+    streambuf* const cout_buffer = cout.rdbuf(output.rdbuf());
+    RemoveNearDuplicates(server);
+    cout.rdbuf(cout_buffer);
+    assert(server.FindNearDuplicates(1).empty());
+    assert(server.GetWordFrequencies(3).size() == 0 && server.GetWordFrequencies(6).size() == 0);
+    assert(server.GetWordFrequencies(4).size() != 0 && server.GetWordFrequencies(5).size() != 0);
+    for (const int document_id : server) {
+        assert(server.FindNearDuplicates(document_id).empty());
+    }
+}
+
+// Слова text с признаком корректности, найденные ForEachWord через find_separators
+template <typename FindSeparators>
+vector<pair<string, bool>> CollectWords(string_view text, FindSeparators find_separators) {
+    vector<pair<string, bool>> words;
+    ForEachWord(text, [&words](string_view word, bool is_valid) {
+        words.emplace_back(word, is_valid);
+    }, find_separators);
+    return words;
+}
+
+void TestTokenizerImplementationsAgree(mt19937& generator) {
+    // Байты на границах: управляющие, пробел и соседи, DEL, байты со старшим битом
+    const string special_bytes = "\x00\x01\x09\x0A\x1F\x20\x21\x7F\x80\xA0\xDF\xE0\xFF"s;
+    const vector<size_t> lengths = {0, 1, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 95, 96, 127, 128, 129, 200};
+    vector<SeparatorSearch> searches;
+    for (const SeparatorSearch search : {SeparatorSearch::SCALAR, SeparatorSearch::SSE2, SeparatorSearch::AVX2}) {
+        if (IsSeparatorSearchSupported(search)) {
+            searches.push_back(search);
+        }
+    }
+
+    for (int iteration = 0; iteration < 3000; ++iteration) {
+        const size_t length = lengths[iteration % lengths.size()];
+        string text(length, 'a');
+        for (char& byte : text) {
+            const int kind = uniform_int_distribution(0, 9)(generator);
+            if (kind < 3) {
+                byte = special_bytes[uniform_int_distribution<size_t>(0, special_bytes.size() - 1)(generator)];
+            } else if (kind < 5) {
+                byte = static_cast<char>(uniform_int_distribution(0, 255)(generator));
+            } else if (kind == 5) {
+                byte = ' ';
+            } else {
+                byte = static_cast<char>(uniform_int_distribution<int>('a', 'z')(generator));
+            }
+        }
+
+        // Побайтовое определение: слова между пробелами, некорректны, если есть байт меньше пробела
+        vector<pair<string, bool>> expected(1, {""s, true});
+        for (const char byte : text) {
+            if (byte == ' ') {
+                expected.emplace_back(""s, true);
+            } else {
+                expected.back().first += byte;
+                expected.back().second = expected.back().second && static_cast<unsigned char>(byte) >= 0x20;
+            }
+        }
+
+        char block[SEPARATOR_BLOCK_SIZE];
+        fill(copy(text.begin(), text.begin() + min(text.size(), SEPARATOR_BLOCK_SIZE), block), block + SEPARATOR_BLOCK_SIZE, 'x');
+        const uint64_t expected_mask = FindSpacesAndControls(block, SeparatorSearch::SCALAR);
+        for (const SeparatorSearch search : searches) {
+            assert(FindSpacesAndControls(block, search) == expected_mask);
+            assert(CollectWords(text, [search](const char* data) {
+                       return FindSpacesAndControls(data, search);
+                   }) == expected);
+        }
+        assert(CollectWords(text, [](const char* data) {
+                   return FindSpacesAndControls(data);
+               }) == expected);
+    }
+}
+
+// Слово из маленького алфавита с нулевым байтом; часто с общим 8-байтным началом,
+// чтобы у разных слов совпадали и длина, и начало
+string GenerateFilterWord(mt19937& generator) {
+    const int kind = uniform_int_distribution(0, 3)(generator);
+    const size_t length = kind == 0 ? uniform_int_distribution<size_t>(0, 8)(generator)
+                                    : uniform_int_distribution<size_t>(0, kind == 3 ? 80 : 12)(generator);
+    string word = kind == 1 ? "prefix__"s : ""s;
+    while (word.size() < length) {
+        word += "ab\0"s[uniform_int_distribution(0, 2)(generator)];
+    }
+    return word;
+}
+
+void TestStopWordFilterMatchesSet(mt19937& generator) {
+    // Размеры вокруг степеней двойки: таблица заполняется ровно до половины и чуть больше
+    for (const size_t size : {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 64, 65, 200}) {
+        set<string, less<>> stop_words;
+        for (int attempt = 0; stop_words.size() < size && attempt < 100000; ++attempt) {
+            stop_words.insert(GenerateFilterWord(generator));
+        }
+        assert(stop_words.size() == size);
+        const StopWordFilter filter(stop_words);
+
+        vector<string> words(stop_words.begin(), stop_words.end());
+        for (const string& stop_word : stop_words) {
+            // Соседи стоп-слова: другой последний байт, короче и длиннее
+            if (!stop_word.empty()) {
+                words.push_back(stop_word.substr(0, stop_word.size() - 1));
+                words.push_back(stop_word.substr(0, stop_word.size() - 1) + (stop_word.back() == 'a' ? 'b' : 'a'));
+            }
+            words.push_back(stop_word + '\0');
+            words.push_back(stop_word + "a"s);
+        }
+        for (int i = 0; i < 500; ++i) {
+            words.push_back(GenerateFilterWord(generator));
+        }
+        words.push_back(""s);
+        words.push_back(string(200, 'a'));
+        for (const string& word : words) {
+            assert(filter.Contains(word) == (stop_words.count(word) == 1));
+        }
+    }
+}
+
+// Одинаковые ли id и релевантности у выдач двух серверов
+void AssertSameDocuments(const vector<Document>& expected, const vector<Document>& found) {
+    assert(expected.size() == found.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        assert(expected[i].id == found[i].id);
+        assert(abs(expected[i].relevance - found[i].relevance) < RELEVANCE_EPSILON);
+        assert(expected[i].rating == found[i].rating);
+    }
+}
+
+void TestQueryPlanCache(const vector<string>& queries) {
+    SearchServer cached_server(TEST_STOP_WORDS);
+    SearchServer uncached_server(TEST_STOP_WORDS);
+    cached_server.SetQueryCacheCapacity(64);
+    const auto add_document = [&](int document_id, const string& document) {
+        cached_server.AddDocument(document_id, document, DocumentStatus::ACTUAL, {document_id});
+        uncached_server.AddDocument(document_id, document, DocumentStatus::ACTUAL, {document_id});
+    };
+    const auto remove_document = [&](int document_id) {
+        cached_server.RemoveDocument(document_id);
+        uncached_server.RemoveDocument(document_id);
+    };
+    const auto assert_same = [&](const string& query) {
+        AssertSameDocuments(uncached_server.FindTopDocuments(query), cached_server.FindTopDocuments(query));
+        AssertSameDocuments(uncached_server.FindTopDocuments(execution::par, query), cached_server.FindTopDocuments(execution::par, query));
+    };
+
+    add_document(1, "cat dog"s);
+    add_document(2, "cat bird"s);
+    const string query = "cat newword -gone"s;
+    assert_same(query);
+    assert_same(query);
+    const auto statistics = cached_server.GetQueryCacheStatistics();
+    assert(statistics.hits > 0);
+
+    // Слово запроса появляется в документах: план с прежними term_id и IDF устарел
+    add_document(3, "newword"s);
+    assert_same(query);
+    assert(cached_server.GetQueryCacheStatistics().misses > statistics.misses);
+    add_document(4, "cat gone"s);
+    assert_same(query);
+    assert(cached_server.FindTopDocuments(query).size() == 3);
+
+    // Освобождённый term_id достаётся другому слову; прежний план не должен его найти
+    remove_document(3);
+    cached_server.CleanupRemovedDocuments();
+    uncached_server.CleanupRemovedDocuments();
+    add_document(5, "otherword"s);
+    assert_same(query);
+    assert_same("otherword"s);
+
+    // Запросы теста вперемешку с изменениями
+    for (int i = 0; i < 200; ++i) {
+        add_document(100 + i, "w"s + to_string(i % 17) + " rare common extra"s + to_string(i));
+        if (i % 3 == 0) {
+            remove_document(100 + i / 2);
+        }
+        assert_same(queries[i % queries.size()]);
+        assert_same(queries[(i * 7) % queries.size()]);
+    }
+}
+
+void TestShardedCacheCapacity() {
+    for (const size_t capacity : {0, 1, 5, 15, 16, 17, 33, 100}) {
+        ShardedLruCache<int> cache(16, capacity);
+        for (int i = 0; i < 1000; ++i) {
+            cache.Insert("key"s + to_string(i), make_shared<const int>(i));
+            assert(cache.GetStatistics().size <= capacity);
+        }
+        assert(capacity == 0 || cache.GetStatistics().size > 0);
+        cache.SetCapacity(capacity / 2);
+        assert(cache.GetStatistics().size <= capacity / 2);
+    }
+}
+
+void TestResultCacheInvalidation() {
+    SearchServer server(TEST_STOP_WORDS);
+    server.SetResultCacheOptions({64, chrono::seconds(60)});
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "cat bird"s, DocumentStatus::ACTUAL, {2});
+    const auto find_ids = [&server](DocumentStatus status) {
+        vector<int> ids;
+        for (const Document& document : server.FindTopDocuments("cat fish"s, status)) {
+            ids.push_back(document.id);
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    assert((find_ids(DocumentStatus::ACTUAL) == vector<int>{1, 2}));
+    assert((find_ids(DocumentStatus::ACTUAL) == vector<int>{1, 2}));
+    assert(server.GetResultCacheStatistics().hits == 1);
+
+    server.AddDocument(3, "fish"s, DocumentStatus::ACTUAL, {3});
+    assert((find_ids(DocumentStatus::ACTUAL) == vector<int>{1, 2, 3}));
+    server.RemoveDocument(1);
+    assert((find_ids(DocumentStatus::ACTUAL) == vector<int>{2, 3}));
+    assert(find_ids(DocumentStatus::BANNED).empty());
+
+    // Смена статуса - удаление и добавление с другим статусом
+    server.RemoveDocument(2);
+    server.AddDocument(2, "cat bird"s, DocumentStatus::BANNED, {2});
+    assert((find_ids(DocumentStatus::ACTUAL) == vector<int>{3}));
+    assert((find_ids(DocumentStatus::BANNED) == vector<int>{2}));
+}
+
+void TestMinusWordsExcludeDocuments(SearchServer& server, const vector<string>& queries) {
+    for (const QueryEngine engine : {QueryEngine::EXHAUSTIVE, QueryEngine::MAX_SCORE}) {
+        server.SetQueryEngine(engine);
+        for (const string& query : queries) {
+            if (query.find('-') == string::npos) {
+                continue;
+            }
+            // Найтись должен ровно тот документ, в котором MatchDocument находит слова запроса
+            const auto relevances = FindAllRelevances(server, query);
+            for (const int document_id : server) {
+                const auto [words, status] = server.MatchDocument(query, document_id);
+                assert(words.empty() != (relevances.count(document_id) == 1));
+            }
+            const auto all_documents = [](int, DocumentStatus, int) {
+                return true;
+            };
+            assert(server.FindTopDocuments(execution::par, query, all_documents, server.GetDocumentCount()).size() == relevances.size());
+        }
+    }
+}
+
+void TestRelevanceAccumulatorMarks() {
+    // Отметки исчерпываются примерно за 32768 запросов. Поздние документы исключены в первом
+    // запросе и больше не встречаются, пока отметки не перейдут через край; потом начисляются
+    // с разных запросов. Старая отметка не должна выдать такой документ за исключённый
+    RelevanceAccumulator accumulator;
+    const size_t regular_count = 7;
+    const size_t late_count = 200;
+    const int first_late_round = 32700;
+    for (int round = 0; round < 40000; ++round) {
+        accumulator.Reset(regular_count + late_count);
+        vector<double> expected(regular_count + late_count, 0.0);
+        const size_t excluded = round % regular_count;
+        accumulator.Exclude(excluded);
+        for (size_t ordinal = 0; ordinal < regular_count; ++ordinal) {
+            if ((ordinal + round) % 3 != 0) {
+                accumulator.Add(ordinal, 1.0);
+                accumulator.Add(ordinal, 0.5);
+                expected[ordinal] = ordinal == excluded ? 0.0 : 1.5;
+            }
+        }
+        for (size_t late = 0; late < late_count; ++late) {
+            const size_t ordinal = regular_count + late;
+            if (round == 0) {
+                accumulator.Exclude(ordinal);
+            } else if (round >= first_late_round + static_cast<int>(late)) {
+                accumulator.Add(ordinal, 2.0);
+                expected[ordinal] = 2.0;
+            }
+        }
+
+        vector<double> found(regular_count + late_count, 0.0);
+        accumulator.ForEach([&found](size_t ordinal, double relevance) {
+            found[ordinal] = relevance;
+        });
+        assert(found == expected);
+    }
+}
+
+void TestMatchDocumentsMatchesMatchDocument(const vector<string>& documents, const vector<string>& queries) {
+    SearchServer server(TEST_STOP_WORDS);
+    const vector<string> first_documents(documents.begin(), documents.begin() + 1000);
+    AddTestDocuments(server, first_documents);
+    vector<int> removed_ids;
+    for (int document_id = 0; document_id < 1000; document_id += 7) {
+        server.RemoveDocument(document_id);
+        removed_ids.push_back(document_id);
+    }
+    vector<int> document_ids(server.begin(), server.end());
+    reverse(document_ids.begin(), document_ids.end());
+
+    for (const string& query : queries) {
+        const auto seq_matches = server.MatchDocuments(execution::seq, query, document_ids);
+        const auto par_matches = server.MatchDocuments(execution::par, query, document_ids);
+        assert(seq_matches == par_matches);
+        assert(seq_matches.size() == document_ids.size());
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            assert(server.MatchDocument(query, document_ids[i]) == seq_matches[i]);
+            assert(server.MatchDocument(execution::par, query, document_ids[i]) == seq_matches[i]);
+        }
+    }
+
+    // Удалённый документ: out_of_range и по одному, и в пакете
+    const string query = queries.front();
+    for (const int removed_id : removed_ids) {
+        for (const bool is_parallel : {false, true}) {
+            try {
+                is_parallel ? server.MatchDocument(execution::par, query, removed_id) : server.MatchDocument(query, removed_id);
+                assert(false);
+            } catch (const out_of_range&) {
+            }
+        }
+    }
+    document_ids.push_back(removed_ids.back());
+    try {
+        server.MatchDocuments(execution::par, query, document_ids);
+        assert(false);
+    } catch (const out_of_range&) {
+    }
+}
+
+}  // namespace
+
+void TestSearchServer() {
+    mt19937 generator;
+    const auto documents = GenerateTestDocuments(generator);
+    const auto queries = GenerateTestQueries(generator);
+
+    SearchServer server(TEST_STOP_WORDS);
+    AddTestDocuments(server, documents);
+    TestFlatIndexMatchesReference(server, documents, queries);
+    TestCompressedMatchesPlain(server, documents, queries);
+    TestMaxScoreMatchesExhaustive(server, queries);
+    TestParallelMatchesSequential(server, queries);
+    TestBatchAddMatchesSequential(execution::seq, server, documents, queries);
+    TestBatchAddMatchesSequential(execution::par, server, documents, queries);
+    TestBatchAddRejectsInvalidDocuments(documents, queries);
+    TestSnapshotRoundTrip(server, queries);
+    TestSegmentMerges(documents, queries);
+    TestConcurrentMatchOwnsWords();
+    TestTermCompaction();
+    TestRemoveDuplicatesMatchesSets(generator);
+    TestNearDuplicates();
+    TestTokenizerImplementationsAgree(generator);
+    TestStopWordFilterMatchesSet(generator);
+    TestQueryPlanCache(queries);
+    TestShardedCacheCapacity();
+    TestResultCacheInvalidation();
+    TestMinusWordsExcludeDocuments(server, queries);
+    TestRelevanceAccumulatorMarks();
+    TestMatchDocumentsMatchesMatchDocument(documents, queries);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Проверки поиска на случайном корпусе: результаты сравниваются с TF-IDF, посчитанным
+// прямо по текстам, и с полным перебором. Запускаются через ./search_server --test;
+// нарушение останавливает программу через assert
+void TestSearchServer();
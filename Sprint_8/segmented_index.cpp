@@ -0,0 +1,267 @@
+#include "segmented_index.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+SegmentedIndex::SegmentsView::SegmentsView(const SegmentedIndex& index)
+: segments_(index.published_segments_.Get())
+{
+}
+
+SegmentedIndex::SegmentList::const_iterator SegmentedIndex::SegmentsView::begin() const {
+    return segments_->begin();
+}
+
+SegmentedIndex::SegmentList::const_iterator SegmentedIndex::SegmentsView::end() const {
+    return segments_->end();
+}
+
+SegmentedIndex::SegmentedIndex(PostingFormat format)
+: format_(format)
+, write_segment_(make_shared<IndexSegment>(format))
+, published_segments_(make_unique<SegmentList>(SegmentList{write_segment_}))
+{
+}
+
+SegmentedIndex::~SegmentedIndex() {
+    {
+        lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    merge_requested_.notify_all();
+    if (merge_thread_.joinable()) {
+        merge_thread_.join();
+    }
+}
+
+void SegmentedIndex::AddDocument(int document_id, const vector<pair<int, double>>& term_freqs) {
+    // Сегмент записи меняется только здесь и не виден фоновому потоку
+    write_segment_->AddDocument(document_id, term_freqs);
+    lock_guard lock(mutex_);
+    if (write_segment_->GetDocumentCount() >= write_segment_size_) {
+        SealWriteSegment();
+    }
+}
+
+void SegmentedIndex::AddSegment(IndexSegment segment) {
+    if (segment.GetDocumentCount() == 0) {
+        return;
+    }
+    lock_guard lock(mutex_);
+    sealed_segments_.push_back(make_shared<IndexSegment>(move(segment)));
+    PublishSegments();
+}
+
+void SegmentedIndex::RemoveDocument(int document_id) {
+    if (write_segment_->MarkDeleted(document_id)) {
+        return;
+    }
+    lock_guard lock(mutex_);
+    for (auto it = sealed_segments_.rbegin(); it != sealed_segments_.rend(); ++it) {
+        if ((*it)->MarkDeleted(document_id)) {
+            RequestMerge();
+            return;
+        }
+    }
+}
+
+void SegmentedIndex::PurgeDeleted() {
+    lock_guard lock(mutex_);
+    if (write_segment_->GetDeletedCount() > 0) {
+        SealWriteSegment();
+    }
+    purge_deleted_ = true;
+    RequestMerge();
+}
+
+SegmentedIndex::SegmentsView SegmentedIndex::GetSegments() const {
+    return SegmentsView(*this);
+}
+
+void SegmentedIndex::SetWriteSegmentSize(size_t document_count) {
+    lock_guard lock(mutex_);
+    // От размера сегмента записи зависят уровни сегментов, поэтому слияние перепроверяется
+    write_segment_size_ = max<size_t>(document_count, 1);
+    if (write_segment_->GetDocumentCount() >= write_segment_size_) {
+        SealWriteSegment();
+    } else if (!sealed_segments_.empty()) {
+        RequestMerge();
+    }
+}
+
+PostingFormat SegmentedIndex::GetFormat() const {
+    return format_;
+}
+
+void SegmentedIndex::SetFormat(PostingFormat format) {
+    unique_lock lock(mutex_);
+    // Пока держим mutex_, новое слияние не начнётся, а текущие уже закончены
+    merge_finished_.wait(lock, [this] {
+        return !merging_ && FindMergeSources().empty();
+    });
+    format_ = format;
+    for (const auto& segment : sealed_segments_) {
+        segment->SetFormat(format);
+    }
+    write_segment_->SetFormat(format);
+}
+
+size_t SegmentedIndex::GetMemoryUsage() const {
+    size_t memory = 0;
+    for (const auto& segment : GetSegments()) {
+        memory += segment->GetMemoryUsage();
+    }
+    return memory;
+}
+
+void SegmentedIndex::WaitForMerges() const {
+    unique_lock lock(mutex_);
+    merge_finished_.wait(lock, [this] {
+        return !merging_ && FindMergeSources().empty();
+    });
+}
+
+void SegmentedIndex::Save(SnapshotWriter& writer) const {
+    // Карты удалений запечатанных сегментов читаем под той же блокировкой, под которой их меняют
+    lock_guard lock(mutex_);
+    writer.WriteValue<uint64_t>(sealed_segments_.size() + 1);
+    for (const auto& segment : sealed_segments_) {
+        segment->Save(writer);
+    }
+    write_segment_->Save(writer);
+}
+
+void SegmentedIndex::Load(SnapshotReader& reader) {
+    const auto segment_count = reader.ReadValue<uint64_t>();
+    for (size_t i = 0; i < segment_count; ++i) {
+        AddSegment(IndexSegment::Load(reader, format_));
+    }
+}
+
+void SegmentedIndex::SealWriteSegment() {
+    if (write_segment_->GetDocumentCount() == 0) {
+        return;
+    }
+    sealed_segments_.push_back(move(write_segment_));
+    write_segment_ = make_shared<IndexSegment>(format_);
+    PublishSegments();
+}
+
+void SegmentedIndex::PublishSegments() {
+    auto segments = make_unique<SegmentList>(sealed_segments_.begin(), sealed_segments_.end());
+    segments->push_back(write_segment_);
+    auto retired = published_segments_.Exchange(move(segments));
+    // Список могут читать прямо сейчас: удалит его фоновый поток, когда читатели выйдут
+    retired_segments_.emplace_back(RcuStartGracePeriod(), move(retired));
+    // Фоновый поток заодно проверит, не пора ли сливать сегменты
+    RequestMerge();
+}
+
+void SegmentedIndex::RequestMerge() {
+    if (!merge_thread_.joinable()) {
+        merge_thread_ = thread([this] {
+            RunMerges();
+        });
+    }
+    merge_requested_.notify_one();
+}
+
+size_t SegmentedIndex::GetLevel(const IndexSegment& segment) const {
+    size_t level = 0;
+    for (size_t bound = write_segment_size_ * MERGE_FACTOR; segment.GetLiveDocumentCount() >= bound; bound *= MERGE_FACTOR) {
+        ++level;
+    }
+    return level;
+}
+
+vector<shared_ptr<IndexSegment>> SegmentedIndex::FindMergeSources() const {
+    map<size_t, vector<shared_ptr<IndexSegment>>> levels;
+    for (const auto& segment : sealed_segments_) {
+        auto& level = levels[GetLevel(*segment)];
+        level.push_back(segment);
+        if (level.size() == MERGE_FACTOR) {
+            return level;
+        }
+    }
+    // Сегмент, в котором удалена больше половины документов, переписывается отдельно
+    for (const auto& segment : sealed_segments_) {
+        if (segment->GetDeletedCount() * 2 > segment->GetDocumentCount()
+            || (purge_deleted_ && segment->GetDeletedCount() > 0)) {
+            return {segment};
+        }
+    }
+    return {};
+}
+
+void SegmentedIndex::RunMerges() {
+    unique_lock lock(mutex_);
+    while (true) {
+        vector<shared_ptr<IndexSegment>> sources;
+        merge_requested_.wait(lock, [&] {
+            if (stop_ || !retired_segments_.empty()) {
+                return true;
+            }
+            sources = FindMergeSources();
+            if (sources.empty()) {
+                purge_deleted_ = false;
+            }
+            return !sources.empty();
+        });
+        if (stop_) {
+            return;
+        }
+        if (!retired_segments_.empty()) {
+            FreeRetiredSegments(lock);
+            continue;
+        }
+
+        vector<const IndexSegment*> source_pointers;
+        vector<vector<bool>> deleted;
+        for (const auto& source : sources) {
+            source_pointers.push_back(source.get());
+            deleted.push_back(source->GetDeleted());
+        }
+        const PostingFormat format = format_;
+        merging_ = true;
+
+        // Словопозиции запечатанных сегментов неизменны, поэтому сливаем без блокировки
+        lock.unlock();
+        auto merged = make_shared<IndexSegment>(IndexSegment::Merge(source_pointers, deleted, format));
+        lock.lock();
+
+        // Документы, удалённые во время слияния, отмечаем и в новом сегменте
+        for (size_t i = 0; i < sources.size(); ++i) {
+            const auto& current_deleted = sources[i]->GetDeleted();
+            for (size_t index = 0; index < current_deleted.size(); ++index) {
+                if (current_deleted[index] && !deleted[i][index]) {
+                    merged->MarkDeleted(sources[i]->GetFirstDocumentId() + static_cast<int>(index));
+                }
+            }
+        }
+
+        const auto first = find(sealed_segments_.begin(), sealed_segments_.end(), sources.front());
+        const size_t first_position = first - sealed_segments_.begin();
+        sealed_segments_.erase(remove_if(sealed_segments_.begin(), sealed_segments_.end(), [&sources](const auto& segment) {
+            return find(sources.begin(), sources.end(), segment) != sources.end();
+        }), sealed_segments_.end());
+        if (merged->GetLiveDocumentCount() > 0) {
+            sealed_segments_.insert(sealed_segments_.begin() + min(first_position, sealed_segments_.size()), move(merged));
+        }
+        PublishSegments();
+        merging_ = false;
+        merge_finished_.notify_all();
+    }
+}
+
+void SegmentedIndex::FreeRetiredSegments(unique_lock<mutex>& lock) {
+    auto retired = move(retired_segments_);
+    retired_segments_.clear();
+    // Пока ждём читателей, mutex_ свободен: читатель может ждать его внутри секции чтения.
+    // Отметки возрастают, поэтому достаточно дождаться последней
+    lock.unlock();
+    RcuWaitForGracePeriod(retired.back().first);
+    retired.clear();
+    lock.lock();
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "index_segment.h"
+#include "rcu.h"
+#include "snapshot_io.h"
+
+// Индекс из сегментов в духе LSM-дерева. Новые документы попадают в небольшой изменяемый
+// сегмент записи; заполненный сегмент запечатывается, и его словопозиции больше не меняются.
+// Фоновый поток сливает запечатанные сегменты одного уровня (по MERGE_FACTOR штук) в более
+// крупный и заодно выбрасывает удалённые документы, поэтому запись не перестраивает большие списки.
+// Поиск проходит по всем сегментам; документ живёт ровно в одном из них.
+// Список сегментов для поиска публикуется через RCU, поэтому чтение не ждёт ни слияния, ни запись.
+// Прежние списки удаляет фоновый поток по окончании периода ожидания, поэтому и запись не ждёт читателей
+class SegmentedIndex {
+public:
+    using SegmentList = std::vector<std::shared_ptr<const IndexSegment>>;
+
+    // Сегменты на момент создания, последним - сегмент записи. Пока объект жив, поток находится
+    // в секции чтения RCU: сегменты не удалятся, даже если фоновое слияние их заменит
+    class SegmentsView {
+    public:
+        explicit SegmentsView(const SegmentedIndex& index);
+
+        SegmentList::const_iterator begin() const;
+        SegmentList::const_iterator end() const;
+
+    private:
+        RcuReadGuard guard_;
+        const SegmentList* segments_;
+    };
+
+    static constexpr size_t DEFAULT_WRITE_SEGMENT_SIZE = 4096;
+    static constexpr size_t MERGE_FACTOR = 4;
+
+    explicit SegmentedIndex(PostingFormat format = PostingFormat::PLAIN);
+    ~SegmentedIndex();
+
+    SegmentedIndex(const SegmentedIndex&) = delete;
+    SegmentedIndex& operator=(const SegmentedIndex&) = delete;
+
+    // term_freqs - пары (term_id, TF) документа
+    void AddDocument(int document_id, const std::vector<std::pair<int, double>>& term_freqs);
+    // Добавляет готовый запечатанный сегмент, например собранный пакетом
+    void AddSegment(IndexSegment segment);
+    void RemoveDocument(int document_id);
+    // Просит фоновый поток переписать все сегменты с удалёнными документами, не дожидаясь,
+    // пока удалённых наберётся больше половины. Сегмент записи при этом запечатывается
+    void PurgeDeleted();
+
+    // Не блокирует. Внутри SegmentsView нельзя менять этот индекс
+    SegmentsView GetSegments() const;
+
+    // Сколько документов набирается в сегменте записи перед запечатыванием
+    void SetWriteSegmentSize(size_t document_count);
+    PostingFormat GetFormat() const;
+    // Ждёт окончания фоновых слияний и перекодирует все сегменты
+    void SetFormat(PostingFormat format);
+    size_t GetMemoryUsage() const;
+
+    // Ждёт, пока не останется сегментов, которые нужно слить
+    void WaitForMerges() const;
+
+    void Save(SnapshotWriter& writer) const;
+    // Добавляет сегменты из снимка как запечатанные
+    void Load(SnapshotReader& reader);
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable merge_requested_;
+    mutable std::condition_variable merge_finished_;
+    std::thread merge_thread_;
+    bool stop_ = false;
+    bool merging_ = false;
+    // Выставляется PurgeDeleted и сбрасывается, когда сегментов с удалёнными не осталось
+    bool purge_deleted_ = false;
+
+    PostingFormat format_;
+    size_t write_segment_size_ = DEFAULT_WRITE_SEGMENT_SIZE;
+    std::shared_ptr<IndexSegment> write_segment_;
+    // Запечатанные сегменты: словопозиции неизменны, карты удалений меняются под mutex_
+    std::vector<std::shared_ptr<IndexSegment>> sealed_segments_;
+    // Копия списка сегментов для поиска, обновляется при каждом изменении состава
+    RcuPointer<SegmentList> published_segments_;
+    // Заменённые списки с отметками периода ожидания, по возрастанию отметок
+    std::vector<std::pair<uint64_t, std::unique_ptr<SegmentList>>> retired_segments_;
+
+    // Вызываются под mutex_. Прежний список сегментов ставится в очередь на удаление
+    void SealWriteSegment();
+    void PublishSegments();
+    void RequestMerge();
+    size_t GetLevel(const IndexSegment& segment) const;
+    std::vector<std::shared_ptr<IndexSegment>> FindMergeSources() const;
+
+    void RunMerges();
+    // Вызывается фоновым потоком под lock: дожидается читателей заменённых списков
+    // и удаляет их, отпустив mutex_ на время ожидания
+    void FreeRetiredSegments(std::unique_lock<std::mutex>& lock);
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Вектор, первые InlineCapacity элементов которого хранятся в самом объекте. Пока элементы
+// помещаются, память не выделяется; дальше они переезжают в std::vector
+template <typename Type, size_t InlineCapacity>
+class SmallVector {
+    static_assert(std::is_trivially_copyable_v<Type> && std::is_default_constructible_v<Type>,
+                  "SmallVector keeps plain values only");
+
+public:
+    Type* begin() {
+        return data();
+    }
+
+    Type* end() {
+        return data() + size_;
+    }
+
+    const Type* begin() const {
+        return data();
+    }
+
+    const Type* end() const {
+        return data() + size_;
+    }
+
+    Type* data() {
+        return heap_items_.empty() ? inline_items_.data() : heap_items_.data();
+    }
+
+    const Type* data() const {
+        return heap_items_.empty() ? inline_items_.data() : heap_items_.data();
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    Type& operator[](size_t index) {
+        return data()[index];
+    }
+
+    const Type& operator[](size_t index) const {
+        return data()[index];
+    }
+
+    void push_back(const Type& value) {
+        if (heap_items_.empty() && size_ < InlineCapacity) {
+            inline_items_[size_++] = value;
+            return;
+        }
+        if (heap_items_.empty()) {
+            heap_items_.reserve(InlineCapacity * 2);
+            heap_items_.assign(inline_items_.begin(), inline_items_.end());
+        }
+        heap_items_.push_back(value);
+        ++size_;
+    }
+
+    // Только уменьшает размер
+    void resize(size_t size) {
+        if (!heap_items_.empty()) {
+            heap_items_.resize(size);
+        }
+        size_ = size;
+    }
+
+    void erase(const Type* first, const Type* last) {
+        Type* target = begin() + (first - begin());
+        for (const Type* item = last; item != end(); ++item) {
+            *target++ = *item;
+        }
+        resize(target - begin());
+    }
+
+private:
+    std::array<Type, InlineCapacity> inline_items_;
+    std::vector<Type> heap_items_;
+    size_t size_ = 0;
+};
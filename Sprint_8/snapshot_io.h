@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "array_view.h"
+
+// Запись двоичного снимка индекса. Каждое значение выравнивается по своему alignof,
+// чтобы при чтении из отображённого в память файла массивы можно было использовать на месте
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::ostream& output)
+    : output_(output) {
+    }
+
+    template <typename Type>
+    void WriteValue(const Type& value) {
+        WriteArray(&value, 1);
+    }
+
+    template <typename Type>
+    void WriteArray(const Type* values, size_t count) {
+        Align(alignof(Type));
+        WriteBytes(values, count * sizeof(Type));
+    }
+
+    void WriteString(std::string_view text) {
+        WriteValue<uint64_t>(text.size());
+        WriteBytes(text.data(), text.size());
+    }
+
+private:
+    std::ostream& output_;
+    size_t offset_ = 0;
+
+    void Align(size_t alignment) {
+        static const char padding[alignof(std::max_align_t)] = {};
+        const size_t padding_size = (alignment - offset_ % alignment) % alignment;
+        WriteBytes(padding, padding_size);
+    }
+
+    void WriteBytes(const void* data, size_t size) {
+        output_.write(static_cast<const char*>(data), size);
+        offset_ += size;
+    }
+};
+
+// Чтение снимка из памяти без копирования: массивы и строки указывают прямо в буфер.
+// Начало буфера должно быть выровнено не хуже max_align_t (у mmap - на границу страницы)
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size)
+    : data_(data)
+    , size_(size) {
+    }
+
+    template <typename Type>
+    Type ReadValue() {
+        Type value;
+        std::memcpy(&value, ReadArray<Type>(1).data(), sizeof(Type));
+        return value;
+    }
+
+    template <typename Type>
+    ArrayView<Type> ReadArray(size_t count) {
+        offset_ += (alignof(Type) - offset_ % alignof(Type)) % alignof(Type);
+        const char* data = ReadBytes(count * sizeof(Type));
+        return {reinterpret_cast<const Type*>(data), count};
+    }
+
+    std::string_view ReadString() {
+        const auto size = ReadValue<uint64_t>();
+        return {ReadBytes(size), size};
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+
+    const char* ReadBytes(size_t size) {
+        if (offset_ > size_ || size > size_ - offset_) {
+            throw std::runtime_error("Index snapshot is truncated");
+        }
+        const char* data = data_ + offset_;
+        offset_ += size;
+        return data;
+    }
+};
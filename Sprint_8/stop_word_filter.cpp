@@ -0,0 +1,25 @@
+#include "stop_word_filter.h"
+
+#include <algorithm>
+
+using namespace std;
+
+StopWordFilter::StopWordFilter(const set<string, less<>>& stop_words) {
+    size_t slot_count = 1;
+    while (slot_count < stop_words.size() * 2) {
+        slot_count *= 2;
+    }
+    slots_.assign(slot_count, Slot{});
+    slot_mask_ = slot_count - 1;
+
+    for (const string& stop_word : stop_words) {
+        const uint64_t prefix = GetPrefix(stop_word);
+        size_t slot_index = MixHash(prefix ^ stop_word.size()) & slot_mask_;
+        while (slots_[slot_index].length != EMPTY_SLOT) {
+            slot_index = (slot_index + 1) & slot_mask_;
+        }
+        slots_[slot_index] = {prefix, static_cast<uint32_t>(stop_word.size()), static_cast<uint32_t>(text_.size())};
+        text_ += stop_word;
+        length_mask_ |= GetLengthBit(stop_word.size());
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hash_mix.h"
+
+// Неизменяемое множество стоп-слов для проверки каждого слова текста. Открытая адресация
+// с заполнением не больше половины; в ячейке хранятся длина и первые 8 байт слова, поэтому
+// слова до 8 байт сравниваются без обращения к строкам. До хеширования слово отсекается
+// по длине: битовая маска длин стоп-слов. Проверка не выделяет память
+class StopWordFilter {
+public:
+    StopWordFilter() = default;
+    explicit StopWordFilter(const std::set<std::string, std::less<>>& stop_words);
+
+    bool Contains(std::string_view word) const {
+        if ((length_mask_ & GetLengthBit(word.size())) == 0) {
+            return false;
+        }
+        const uint64_t prefix = GetPrefix(word);
+        for (size_t slot_index = MixHash(prefix ^ word.size()) & slot_mask_;; slot_index = (slot_index + 1) & slot_mask_) {
+            const Slot& slot = slots_[slot_index];
+            if (slot.length == EMPTY_SLOT) {
+                return false;
+            }
+            if (slot.prefix == prefix && slot.length == word.size()
+                && (word.size() <= PREFIX_SIZE
+                    || std::memcmp(text_.data() + slot.offset + PREFIX_SIZE, word.data() + PREFIX_SIZE, word.size() - PREFIX_SIZE) == 0)) {
+                return true;
+            }
+        }
+    }
+
+private:
+    static constexpr size_t PREFIX_SIZE = sizeof(uint64_t);
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    struct Slot {
+        uint64_t prefix = 0;
+        uint32_t length = EMPTY_SLOT;
+        // Начало слова в text_
+        uint32_t offset = 0;
+    };
+
+    // Стоп-слова подряд; фильтр владеет ими, чтобы не зависеть от времени жизни множества
+    std::string text_;
+    std::vector<Slot> slots_ = std::vector<Slot>(1);
+    size_t slot_mask_ = 0;
+    // Бит i - есть стоп-слово длины i; все длины от 63 и больше делят старший бит
+    uint64_t length_mask_ = 0;
+
+    static uint64_t GetLengthBit(size_t length) {
+        return uint64_t{1} << std::min<size_t>(length, 63);
+    }
+
+    static uint64_t GetPrefix(std::string_view word) {
+        uint64_t prefix = 0;
+        std::memcpy(&prefix, word.data(), std::min(word.size(), PREFIX_SIZE));
+        return prefix;
+    }
+};
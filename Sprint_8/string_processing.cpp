@@ -1,20 +1,100 @@
 #include "string_processing.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TOKENIZER_X86
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
-vector<string_view> SplitIntoWords(string_view text) {
-    vector<string_view> words;
-    while (true){
-        const auto space_pos = text.find(' ');
-        words.push_back(text.substr(0,space_pos));
-        if (space_pos == text.npos){
-            break;
-        } else {
-            text.remove_prefix(space_pos+1);
-        }
+namespace {
+// Пробел - 0x20, управляющие символы - 0x00..0x1F: ищем байты не больше 0x20
+const unsigned char MAX_SEPARATOR_BYTE = ' ';
+
+uint64_t FindSpacesAndControlsScalar(const char* data) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < SEPARATOR_BLOCK_SIZE; ++i) {
+        mask |= static_cast<uint64_t>(static_cast<unsigned char>(data[i]) <= MAX_SEPARATOR_BYTE) << i;
     }
-    return words;
+    return mask;
 }
 
+#ifdef SIMD_TOKENIZER_X86
+// Сравнения байтов в SSE2 и AVX2 знаковые, поэтому «не больше 0x20» проверяем как min(v, 0x20) == v
+uint64_t FindSpacesAndControlsSse2(const char* data) {
+    const __m128i max_separator = _mm_set1_epi8(static_cast<char>(MAX_SEPARATOR_BYTE));
+    uint64_t mask = 0;
+    for (size_t i = 0; i < SEPARATOR_BLOCK_SIZE; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const uint64_t part = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes, max_separator), bytes)));
+        mask |= part << i;
+    }
+    return mask;
+}
 
+__attribute__((target("avx2")))
+uint64_t FindSpacesAndControlsAvx2(const char* data) {
+    const __m256i max_separator = _mm256_set1_epi8(static_cast<char>(MAX_SEPARATOR_BYTE));
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+    const uint64_t low_mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(low, max_separator), low)));
+    const uint64_t high_mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(high, max_separator), high)));
+    return low_mask | (high_mask << 32);
+}
+#endif
+
+using FindFunction = uint64_t (*)(const char*);
+
+FindFunction ChooseFindSpacesAndControls() {
+#ifdef SIMD_TOKENIZER_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return FindSpacesAndControlsAvx2;
+    }
+    return FindSpacesAndControlsSse2;
+#else
+    return FindSpacesAndControlsScalar;
+#endif
+}
+}
 
+uint64_t FindSpacesAndControls(const char* data) {
+    // Выбор внутри функции: её могут вызвать и при инициализации глобальных объектов
+    static const FindFunction find_spaces_and_controls = ChooseFindSpacesAndControls();
+    return find_spaces_and_controls(data);
+}
+
+bool IsSeparatorSearchSupported(SeparatorSearch search) {
+    switch (search) {
+    case SeparatorSearch::SCALAR:
+        return true;
+#ifdef SIMD_TOKENIZER_X86
+    case SeparatorSearch::SSE2:
+        return true;
+    case SeparatorSearch::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+uint64_t FindSpacesAndControls(const char* data, SeparatorSearch search) {
+    switch (search) {
+#ifdef SIMD_TOKENIZER_X86
+    case SeparatorSearch::SSE2:
+        return FindSpacesAndControlsSse2(data);
+    case SeparatorSearch::AVX2:
+        return FindSpacesAndControlsAvx2(data);
+#endif
+    default:
+        return FindSpacesAndControlsScalar(data);
+    }
+}
+
+vector<string_view> SplitIntoWords(string_view text) {
+    vector<string_view> words;
+    ForEachWord(text, [&words](string_view word, bool) {
+        words.push_back(word);
+    });
+    return words;
+}
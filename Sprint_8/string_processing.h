@@ -1,10 +1,73 @@
 #pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <set>
 #include <vector>
 #include <string>
+#include <string_view>
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+const size_t SEPARATOR_BLOCK_SIZE = 64;
+
+// Битовая маска байтов data[0..SEPARATOR_BLOCK_SIZE), которые являются пробелом или управляющим
+// символом (коды 0-31): бит i - байт data[i]. Блок проверяется по 32 (AVX2) или 16 (SSE2) байт;
+// набор инструкций выбирается при первом вызове, без них - побайтовый просмотр
+uint64_t FindSpacesAndControls(const char* data);
+
+// Реализации FindSpacesAndControls; выбирать конкретную нужно только для проверок
+enum class SeparatorSearch {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+// false, если набора инструкций нет на этой платформе или у процессора
+bool IsSeparatorSearchSupported(SeparatorSearch search);
+// FindSpacesAndControls заданной реализацией; она должна поддерживаться
+uint64_t FindSpacesAndControls(const char* data, SeparatorSearch search);
+
+// Разбивает text на слова по пробелам так же, как SplitIntoWords, но без выделения памяти:
+// вызывает callback(word, is_valid) для каждого слова по порядку. is_valid == false, если
+// в слове есть управляющие символы. Разбиение и проверка идут за один проход по тексту.
+// find_separators(data) - замена FindSpacesAndControls, например с выбранной реализацией
+template <typename Callback, typename FindSeparators>
+void ForEachWord(std::string_view text, Callback callback, FindSeparators find_separators) {
+    size_t word_begin = 0;
+    bool is_valid = true;
+    auto process_block = [&](size_t block_begin, uint64_t mask) {
+        for (; mask != 0; mask &= mask - 1) {
+            const size_t pos = block_begin + __builtin_ctzll(mask);
+            if (text[pos] == ' ') {
+                callback(text.substr(word_begin, pos - word_begin), is_valid);
+                word_begin = pos + 1;
+                is_valid = true;
+            } else {
+                is_valid = false;
+            }
+        }
+    };
+    size_t block_begin = 0;
+    for (; block_begin + SEPARATOR_BLOCK_SIZE <= text.size(); block_begin += SEPARATOR_BLOCK_SIZE) {
+        process_block(block_begin, find_separators(text.data() + block_begin));
+    }
+    if (block_begin < text.size()) {
+        // Хвост короче блока дополняем байтами, которые не бывают разделителями
+        char tail[SEPARATOR_BLOCK_SIZE];
+        std::fill(std::copy(text.begin() + block_begin, text.end(), tail), tail + SEPARATOR_BLOCK_SIZE, 'x');
+        process_block(block_begin, find_separators(tail));
+    }
+    callback(text.substr(word_begin), is_valid);
+}
+
+template <typename Callback>
+void ForEachWord(std::string_view text, Callback callback) {
+    ForEachWord(text, callback, [](const char* data) {
+        return FindSpacesAndControls(data);
+    });
+}
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -15,4 +78,3 @@ std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContain
     }
     return non_empty_strings;
 }
-
@@ -0,0 +1,40 @@
+#include "text_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+string_view TextArena::Append(string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    if (chunk_size_ - chunk_used_ < text.size()) {
+        // Тексты длиннее блока получают отдельный блок по размеру
+        chunk_size_ = max(CHUNK_SIZE, text.size());
+        chunks_.push_back(make_unique<char[]>(chunk_size_));
+        chunk_used_ = 0;
+        allocated_bytes_ += chunk_size_;
+    }
+    char* data = chunks_.back().get() + chunk_used_;
+    memcpy(data, text.data(), text.size());
+    chunk_used_ += text.size();
+    used_bytes_ += text.size();
+    return {data, text.size()};
+}
+
+void TextArena::Release(string_view text) {
+    released_bytes_ += text.size();
+}
+
+size_t TextArena::GetUsedBytes() const {
+    return used_bytes_;
+}
+
+size_t TextArena::GetReleasedBytes() const {
+    return released_bytes_;
+}
+
+size_t TextArena::GetMemoryUsage() const {
+    return allocated_bytes_;
+}
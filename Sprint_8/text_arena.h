@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Хранилище строк, дописываемое в конец: тексты лежат в крупных блоках,
+// возвращённые string_view остаются валидными до уничтожения хранилища.
+// Освобождённые тексты только учитываются; место возвращается пересборкой в новое хранилище
+class TextArena {
+public:
+    static constexpr size_t CHUNK_SIZE = 1 << 20;
+
+    std::string_view Append(std::string_view text);
+    // Помечает ранее добавленный текст как удалённый
+    void Release(std::string_view text);
+
+    size_t GetUsedBytes() const;
+    size_t GetReleasedBytes() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    size_t chunk_size_ = 0;
+    size_t chunk_used_ = 0;
+    size_t allocated_bytes_ = 0;
+    size_t used_bytes_ = 0;
+    size_t released_bytes_ = 0;
+};